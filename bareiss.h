@@ -0,0 +1,165 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "biginteger.h"
+#include "gcd.h"
+#include "rational.h"
+#include "threadpool.h"
+
+// Fraction-free (Bareiss) elimination for matrices over Rational. Every row is
+// multiplied by the least common multiple of its denominators once, the
+// elimination then works on BigInteger entries only: each update
+// a[t][s] = (pivot * a[t][s] - a[t][i] * a[k][s]) / previousPivot
+// divides exactly, and every entry stays a minor of the integer matrix.
+
+// Multiplies count values, stride apart, by the least common multiple of their
+// denominators and stores the integers integerStride apart. Returns the multiplier.
+BigInteger clearDenominators(const Rational *values, size_t count, BigInteger *integers, size_t stride = 1,
+                             size_t integerStride = 1) {
+    BigInteger scale = 1;
+    for (size_t j = 0; j < count; ++j) {
+        BigInteger denominator = values[j * stride].getDenominator();
+        if (denominator != 1 && scale % denominator != 0) {
+            scale = scale / GCD(scale, denominator) * denominator;
+        }
+    }
+    for (size_t j = 0; j < count; ++j) {
+        const Rational &value = values[j * stride];
+        BigInteger denominator = value.getDenominator();
+        integers[j * integerStride] = denominator == 1 ? value.getNumerator() * scale
+                                                       : value.getNumerator() * (scale / denominator);
+    }
+    return scale;
+}
+
+// Forward elimination of the rows x columns integer matrix in data. Returns the
+// rank; determinantSign is flipped on every row swap and lastPivot receives the
+// last pivot, which equals +-det for a non-singular square matrix.
+size_t bareissEliminate(BigInteger *data, size_t rows, size_t columns, int &determinantSign, BigInteger &lastPivot) {
+    BigInteger previous = 1;
+    size_t k = 0;
+    for (size_t i = 0; i < columns && k < rows; ++i) {
+        size_t j = k;
+        while (j < rows && data[j * columns + i] == 0) {
+            ++j;
+        }
+        if (j == rows) {
+            continue;
+        }
+        if (j != k) {
+            std::swap_ranges(data + j * columns, data + (j + 1) * columns, data + k * columns);
+            determinantSign = -determinantSign;
+        }
+        const BigInteger *pivotRow = data + k * columns;
+        const BigInteger &pivot = pivotRow[i];
+        const bool divide = previous != 1;
+        parallelFor(k + 1, rows, 1, [&](size_t from, size_t to) {
+            for (size_t t = from; t < to; ++t) {
+                BigInteger *row = data + t * columns;
+                const bool eliminated = row[i] == 0;
+                for (size_t s = i + 1; s < columns; ++s) {
+                    row[s] = eliminated ? pivot * row[s] : pivot * row[s] - row[i] * pivotRow[s];
+                    if (divide) {
+                        row[s] /= previous;
+                    }
+                }
+                row[i] = 0;
+            }
+        });
+        previous = pivot;
+        ++k;
+    }
+    lastPivot = previous;
+    return k;
+}
+
+Rational bareissDet(const Rational *values, size_t n) {
+    std::vector<BigInteger> integers(n * n);
+    BigInteger scales = 1;
+    for (size_t i = 0; i < n; ++i) {
+        scales *= clearDenominators(values + i * n, n, integers.data() + i * n);
+    }
+    int sign = 1;
+    BigInteger lastPivot;
+    if (bareissEliminate(integers.data(), n, n, sign, lastPivot) < n) {
+        return Rational(0);
+    }
+    return Rational(sign == 1 ? lastPivot : -lastPivot, scales);
+}
+
+size_t bareissRank(const Rational *values, size_t rows, size_t columns) {
+    std::vector<BigInteger> integers(rows * columns);
+    for (size_t i = 0; i < rows; ++i) {
+        clearDenominators(values + i * columns, columns, integers.data() + i * columns);
+    }
+    int sign = 1;
+    BigInteger lastPivot;
+    return bareissEliminate(integers.data(), rows, columns, sign, lastPivot);
+}
+
+// Fraction-free Gauss-Jordan elimination of [A | I], where A is the integer
+// matrix S * values with S = diag(row scales). It ends with [d * I | d * A^-1],
+// so values^-1 = A^-1 * S has the entries adjugate[i][j] * scale[j] / d.
+// As in invertInPlace, column k of the right half is kept where column k of A
+// is eliminated: the columns of d * I to its left and of the identity to its
+// right are implicit, so one n x n integer buffer is enough. result may be
+// values. Returns false for a singular matrix and leaves result unchanged.
+bool bareissInverse(const Rational *values, size_t n, Rational *result) {
+    std::vector<BigInteger> data(n * n);
+    std::vector<BigInteger> scales(n);
+    for (size_t i = 0; i < n; ++i) {
+        scales[i] = clearDenominators(values + i * n, n, data.data() + i * n);
+    }
+    std::vector<size_t> swaps(n);
+    BigInteger previous = 1;
+    for (size_t k = 0; k < n; ++k) {
+        size_t j = k;
+        while (j < n && data[j * n + k] == 0) {
+            ++j;
+        }
+        if (j == n) {
+            return false;
+        }
+        swaps[k] = j;
+        if (j != k) {
+            std::swap_ranges(data.begin() + j * n, data.begin() + (j + 1) * n, data.begin() + k * n);
+        }
+        const BigInteger *pivotRow = data.data() + k * n;
+        const BigInteger &pivot = pivotRow[k];
+        const bool divide = previous != 1;
+        parallelFor(0, n, 1, [&](size_t from, size_t to) {
+            for (size_t t = from; t < to; ++t) {
+                if (t == k) {
+                    continue;
+                }
+                BigInteger *row = data.data() + t * n;
+                const bool eliminated = row[k] == 0;
+                for (size_t s = 0; s < n; ++s) {
+                    if (s == k) {
+                        continue;
+                    }
+                    row[s] = eliminated ? pivot * row[s] : pivot * row[s] - row[k] * pivotRow[s];
+                    if (divide) {
+                        row[s] /= previous;
+                    }
+                }
+                row[k] = -row[k];
+            }
+        });
+        std::swap(data[k * n + k], previous);
+    }
+    for (size_t k = n - 1; k + 1 != 0; --k) {
+        if (swaps[k] != k) {
+            for (size_t i = 0; i < n; ++i) {
+                std::swap(data[i * n + k], data[i * n + swaps[k]]);
+            }
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            result[i * n + j] = Rational(data[i * n + j] * scales[j], previous);
+        }
+    }
+    return true;
+}
@@ -1,10 +1,20 @@
-#include <iostream>
+#pragma once
 
-const int BASE = 1000'000'000;
-const int BASE_CNT = 9;
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <type_traits>
+#include <vector>
+#include "limbbuffer.h"
+#include "limbs.h"
 
 class BigInteger;
 class Rational;
+struct GcdMatrix;
+struct GcdCofactors;
 
 BigInteger operator+(const BigInteger &first, const BigInteger &second);
 BigInteger operator-(const BigInteger &first, const BigInteger &second);
@@ -17,187 +27,258 @@ bool operator<(const BigInteger &first, const BigInteger &second);
 bool operator>(const BigInteger &first, const BigInteger &second);
 bool operator<=(const BigInteger &first, const BigInteger &second);
 bool operator>=(const BigInteger &first, const BigInteger &second);
-BigInteger GCD(BigInteger first, BigInteger second);
+std::pair<BigInteger, BigInteger> divmod(const BigInteger &first, const BigInteger &second);
+std::string decimalString(const BigInteger &number);
 
 class BigInteger {
 private:
-    std::vector<int> digits;
-    size_t size = 0;
+    LimbBuffer digits;
     int sign = 1;
 
-public:
-    BigInteger() = default;
+    size_t size() const {
+        return digits.size();
+    }
 
-    BigInteger(const int &number) : digits(0), size(0), sign(1) {
-        long long longNumber = number;
-        if (number < 0) {
-            sign = -1;
-            longNumber *= -1;
+    void removeLeadingZeros() {
+        digits.resize(trimmedLength(digits.data(), digits.size()));
+        if (digits.empty()) {
+            sign = 1;
         }
-        while (longNumber > 0) {
-            digits.push_back(int(longNumber % BASE));
-            longNumber /= BASE;
+    }
+
+    static BigInteger fromLimbs(const Limb *limbs, size_t count) {
+        BigInteger result;
+        result.digits.assign(limbs, limbs + trimmedLength(limbs, count));
+        return result;
+    }
+
+    // Limbs [offset, offset + count) of the absolute value.
+    BigInteger limbRange(size_t offset, size_t count) const {
+        if (offset >= size()) {
+            return BigInteger();
         }
-        size = digits.size();
+        return fromLimbs(digits.data() + offset, std::min(count, size() - offset));
     }
 
-    std::string toString() const {
-        std::string result;
-        for (size_t i = 0; i < size; ++i) {
-            int digit = digits[i];
-            int cnt = 0;
-            while (digit > 0) {
-                digit /= 10;
-                ++cnt;
-            }
-            digit = digits[i];
-            while (digit > 0) {
-                result += char(digit % 10 + '0');
-                digit /= 10;
-            }
-            if (i != size - 1) {
-                for (int j = cnt; j < BASE_CNT; ++j) {
-                    result += '0';
-                }
-            }
+    // |this| * 2^(32 count).
+    BigInteger shiftedLimbs(size_t count) const {
+        BigInteger result;
+        if (size() > 0) {
+            result.digits.resize(count + size());
+            std::copy(digits.data(), digits.data() + size(), result.digits.data() + count);
+            result.sign = sign;
         }
-        if (sign == -1) {
-            result += '-';
+        return result;
+    }
+
+    // |this| * 2^count.
+    BigInteger shiftedBits(size_t count) const {
+        BigInteger result = shiftedLimbs(count / LIMB_BITS);
+        const Limb carry = multiplyAddWord(result.digits.data(), result.size(), Limb(1) << (count % LIMB_BITS), 0);
+        if (carry > 0) {
+            result.digits.push_back(carry);
         }
-        for (size_t i = 0; i < result.size() / 2; ++i) {
-            std::swap(result[i], result[result.size() - i - 1]);
+        return result;
+    }
+
+    static BigInteger fromWord(unsigned __int128 value) {
+        BigInteger result;
+        while (value > 0) {
+            result.digits.push_back(Limb(value));
+            value >>= LIMB_BITS;
         }
-        if (result.empty()) {
-            result += '0';
+        return result;
+    }
+
+    static BigInteger fromWide(__int128 value) {
+        BigInteger result = fromWord(value < 0 ? -(unsigned __int128)(value) : (unsigned __int128)(value));
+        if (value < 0) {
+            result.sign = -1;
         }
         return result;
     }
 
-    BigInteger operator-() const {
-        BigInteger result = *this;
-        if (result.size > 0) result.sign *= -1;
+    // Stores the value in word if it lies strictly between -2^63 and 2^63.
+    bool toWord(int64_t &word) const {
+        if (!fitsWord(digits.data(), size())) {
+            return false;
+        }
+        word = wordValue(digits.data(), size()) * sign;
+        return true;
+    }
+
+    // x * |first| + y * |second|, where the result is known to be non-negative.
+    static BigInteger linearCombination(const BigInteger &first, int64_t x, const BigInteger &second, int64_t y) {
+        BigInteger result;
+        result.digits.resize(std::max(first.size(), second.size()) + 3);
+        combineLimbs(first.digits.data(), first.size(), x, second.digits.data(), second.size(), y,
+                     result.digits.data(), result.digits.size());
+        result.removeLeadingZeros();
         return result;
     }
 
-    BigInteger &operator+=(const BigInteger &another) {
-        BigInteger first = *this;
-        BigInteger second = another;
-        first.sign = 1;
-        second.sign = 1;
-        bool firstIsBigger = (first >= second);
-        BigInteger& big = firstIsBigger ? first : second;
-        BigInteger& little = firstIsBigger ? second : first;
-        digits.resize(big.size);
-        little.digits.resize(big.size);
-        if (sign != another.sign) {
-            int subtract = 0;
-            for (size_t i = 0; i < big.size; ++i) {
-                int digit = big.digits[i] - little.digits[i] - subtract;
-                subtract = 0;
-                if (digit < 0) {
-                    digit += BASE;
-                    subtract = 1;
-                }
-                digits[i] = digit;
+    // this += anotherSign * |another|.
+    void addSigned(const BigInteger &another, int anotherSign) {
+        if (another.size() == 0) {
+            return;
+        }
+        if (size() == 0) {
+            digits = another.digits;
+            sign = anotherSign;
+            return;
+        }
+        if (sign == anotherSign) {
+            if (size() < another.size()) {
+                digits.resize(another.size());
             }
-            sign = (firstIsBigger && sign == -1) || (!firstIsBigger && another.sign == -1) ? -1 : 1;
-            while (!digits.empty() && digits.back() == 0) {
-                digits.pop_back();
+            if (addLimbs(digits.data(), size(), another.digits.data(), another.size())) {
+                digits.push_back(1);
             }
-            size = digits.size();
-            if (size == 0) {
-                sign = 1;
+            return;
+        }
+        if (compareLimbs(digits.data(), size(), another.digits.data(), another.size()) >= 0) {
+            subtractLimbs(digits.data(), size(), another.digits.data(), another.size());
+        } else {
+            const size_t length = size();
+            digits.resize(another.size());
+            Limb borrow = subtractBorrow(another.digits.data(), digits.data(), digits.data(), length, 0);
+            for (size_t i = length; i < another.size(); ++i) {
+                digits[i] = another.digits[i] - borrow;
+                borrow = another.digits[i] < borrow;
             }
-            return *this;
+            sign = anotherSign;
         }
-        int add = 0;
-        for (size_t i = 0; i < digits.size(); ++i) {
-            long long digit = 1LL * big.digits[i] + little.digits[i] + add;
-            digits[i] = int(digit % BASE);
-            add = int(digit / BASE);
+        removeLeadingZeros();
+    }
+
+    // |this| += |another| * 2^(32 shift).
+    void addShifted(const BigInteger &another, size_t shift) {
+        if (digits.size() < another.size() + shift + 1) {
+            digits.resize(another.size() + shift + 1, 0);
         }
-        if (add > 0) {
-            digits.push_back(add);
+        addLimbs(digits.data() + shift, digits.size() - shift, another.digits.data(), another.size());
+        removeLeadingZeros();
+    }
+
+    // Toom-Cook 3 for operands of comparable length: both are split into three
+    // pieces of k limbs, the product polynomial is evaluated at 0, 1, -1, -2
+    // and infinity and interpolated with Bodrato's sequence.
+    static BigInteger multiplyToom3(const BigInteger &first, const BigInteger &second) {
+        const size_t k = (std::max(first.size(), second.size()) + 2) / 3;
+        const BigInteger a0 = first.limbRange(0, k);
+        const BigInteger a1 = first.limbRange(k, k);
+        const BigInteger a2 = first.limbRange(2 * k, k);
+        const BigInteger b0 = second.limbRange(0, k);
+        const BigInteger b1 = second.limbRange(k, k);
+        const BigInteger b2 = second.limbRange(2 * k, k);
+
+        BigInteger pa = a0 + a2;
+        BigInteger pb = b0 + b2;
+        const BigInteger aMinusOne = pa - a1;
+        const BigInteger bMinusOne = pb - b1;
+        BigInteger aMinusTwo = aMinusOne + a2;
+        aMinusTwo += aMinusTwo;
+        aMinusTwo -= a0;
+        BigInteger bMinusTwo = bMinusOne + b2;
+        bMinusTwo += bMinusTwo;
+        bMinusTwo -= b0;
+        pa += a1;
+        pb += b1;
+
+        const BigInteger r0 = a0 * b0;
+        BigInteger r1 = pa * pb;
+        const BigInteger rMinusOne = aMinusOne * bMinusOne;
+        const BigInteger rMinusTwo = aMinusTwo * bMinusTwo;
+        const BigInteger rInfinity = a2 * b2;
+
+        BigInteger r3 = rMinusTwo - r1;
+        r3 /= 3;
+        r1 -= rMinusOne;
+        r1 /= 2;
+        BigInteger r2 = rMinusOne - r0;
+        r3 = r2 - r3;
+        r3 /= 2;
+        r3 += rInfinity;
+        r3 += rInfinity;
+        r2 += r1;
+        r2 -= rInfinity;
+        r1 -= r3;
+
+        BigInteger result = r0;
+        result.addShifted(r1, k);
+        result.addShifted(r2, 2 * k);
+        result.addShifted(r3, 3 * k);
+        result.addShifted(rInfinity, 4 * k);
+        return result;
+    }
+
+    // |first| * |second|: Toom-Cook 3 for long balanced operands, otherwise the
+    // limb kernels (schoolbook or Karatsuba).
+    static BigInteger multiplyAbsolute(const BigInteger &first, const BigInteger &second) {
+        const BigInteger &longer = first.size() >= second.size() ? first : second;
+        const BigInteger &shorter = first.size() >= second.size() ? second : first;
+        BigInteger result;
+        if (shorter.size() >= TOOM3_THRESHOLD) {
+            if (longer.size() < 2 * shorter.size()) {
+                return multiplyToom3(longer, shorter);
+            }
+            for (size_t offset = 0; offset < longer.size(); offset += shorter.size()) {
+                result.addShifted(multiplyAbsolute(longer.limbRange(offset, shorter.size()), shorter), offset);
+            }
+            return result;
+        }
+        result.digits.resize(first.size() + second.size());
+        multiplyLimbs(first.digits.data(), first.size(), second.digits.data(), second.size(), result.digits.data());
+        result.removeLeadingZeros();
+        return result;
+    }
+
+public:
+    BigInteger() = default;
+
+    BigInteger(const int &number) : sign(number < 0 ? -1 : 1) {
+        if (number != 0) {
+            digits.push_back(number < 0 ? Limb(-int64_t(number)) : Limb(number));
         }
-        size = digits.size();
+    }
+
+    std::string toString() const {
+        return decimalString(*this);
+    }
+
+    BigInteger operator-() const {
+        BigInteger result = *this;
+        if (result.size() > 0) result.sign *= -1;
+        return result;
+    }
+
+    BigInteger &operator+=(const BigInteger &another) {
+        addSigned(another, another.sign);
         return *this;
     }
 
     BigInteger &operator-=(const BigInteger &another) {
-        BigInteger copy = another;
-        copy.sign *= -1;
-        *this += copy;
+        addSigned(another, -another.sign);
         return *this;
     }
 
     BigInteger &operator*=(const BigInteger &another) {
-        BigInteger result;
-        result.digits.resize(size + another.size, 0);
-        for (size_t i = 0; i < size; ++i) {
-            int add = 0;
-            for (size_t j = 0; j < another.size || add; ++j) {
-                long long digitFromAnother = j < another.size ? another.digits[j] : 0;
-                long long digit = result.digits[i + j] + 1LL * digits[i] * digitFromAnother + add;
-                result.digits[i + j] = int(digit % BASE);
-                add = int(digit / BASE);
-            }
-        }
-        while (!result.digits.empty() && result.digits.back() == 0) {
-            result.digits.pop_back();
-        }
-        result.size = result.digits.size();
+        BigInteger result = multiplyAbsolute(*this, another);
         result.sign = sign * another.sign;
-        if (result.size == 0) {
+        if (result.size() == 0) {
             result.sign = 1;
         }
-        *this = result;
+        *this = std::move(result);
         return *this;
     }
 
     BigInteger &operator/=(const BigInteger &another) {
-        BigInteger result = 0;
-        BigInteger residue = 0;
-        BigInteger absAnother = another;
-        absAnother.sign = 1;
-        for (size_t i = size - 1; i + 1 != 0; --i) {
-            residue = residue * BASE;
-            residue += digits[i];
-            if (residue >= absAnother) {
-                int leftQuotient = 0;
-                int rightQuotient = BASE;
-                while (rightQuotient - leftQuotient > 1) {
-                    int quotient = leftQuotient + (rightQuotient - leftQuotient) / 2;
-                    absAnother * quotient <= residue ? leftQuotient = quotient : rightQuotient = quotient;
-                }
-                result.digits.push_back(leftQuotient);
-                residue -= absAnother * leftQuotient;
-            } else if (!result.digits.empty()) {
-                result.digits.push_back(0);
-            }
-        }
-        result.size = result.digits.size();
-        for (size_t i = 0; i < result.size / 2; ++i) {
-            std::swap(result.digits[i], result.digits[result.size - i - 1]);
-        }
-        result.sign = sign * another.sign;
-        if (result.size == 0) {
-            result.sign = 1;
-        }
-        *this = result;
+        *this = std::move(divmod(*this, another).first);
         return *this;
     }
 
     BigInteger &operator%=(const BigInteger &another) {
-        BigInteger abs = *this;
-        BigInteger absAnother = another;
-        abs.sign = 1;
-        absAnother.sign = 1;
-        BigInteger result = abs - (abs / absAnother) * absAnother;
-        result.sign = sign;
-        if (result.size == 0) {
-            result.sign = 1;
-        }
-        *this = result;
+        *this = std::move(divmod(*this, another).second);
         return *this;
     }
 
@@ -207,17 +288,16 @@ public:
             return *this;
         }
         size_t index = 0;
-        while (index < size && ((sign == -1 && digits[index] == 9) || (sign == 1 && digits[index] == 0))) {
-            digits[index] = sign == -1 ? 0 : 9;
+        while (index < size() && ((sign == -1 && digits[index] == LIMB_MAX) || (sign == 1 && digits[index] == 0))) {
+            digits[index] = sign == -1 ? 0 : LIMB_MAX;
             ++index;
         }
-        if (index == size) {
+        if (index == size()) {
             digits.push_back(1);
         } else {
             digits[index] += 1 - 2 * (sign == 1);
-            if (digits[index] == 0 && index == size - 1) {
+            if (digits[index] == 0 && index == size() - 1) {
                 digits.pop_back();
-                --size;
             }
         }
         return *this;
@@ -234,17 +314,16 @@ public:
             return *this;
         }
         size_t index = 0;
-        while (index < size && ((sign == -1 && digits[index] == 0) || (sign == 1 && digits[index] == 9))) {
-            digits[index] = sign == -1 ? 9 : 0;
+        while (index < size() && ((sign == -1 && digits[index] == 0) || (sign == 1 && digits[index] == LIMB_MAX))) {
+            digits[index] = sign == -1 ? LIMB_MAX : 0;
             ++index;
         }
-        if (index == size) {
+        if (index == size()) {
             digits.push_back(1);
         } else {
             digits[index] += 1 - 2 * (sign == -1);
-            if (digits[index] == 0 && index == size - 1) {
+            if (digits[index] == 0 && index == size() - 1) {
                 digits.pop_back();
-                --size;
             }
         }
         return *this;
@@ -256,35 +335,54 @@ public:
     }
 
     explicit operator bool() const {
-        return size > 0;
+        return size() > 0;
+    }
+
+    // Number of limbs, a cheap measure of the magnitude for cost estimates.
+    size_t limbs() const {
+        return size();
+    }
+
+    // Number of significant bits of |this|.
+    size_t bitLength() const {
+        return size() == 0 ? 0 : LIMB_BITS * size() - size_t(__builtin_clz(digits.back()));
+    }
+
+    // Bit index of |this|, the lowest one being bit 0.
+    bool bit(size_t index) const {
+        return index / LIMB_BITS < size() && (digits[index / LIMB_BITS] >> (index % LIMB_BITS)) & 1;
+    }
+
+    // Non-negative remainder modulo a positive int.
+    int residue(int modulus) const {
+        uint64_t result = 0;
+        for (size_t i = size(); i-- > 0;) {
+            result = ((result << LIMB_BITS) | digits[i]) % uint64_t(modulus);
+        }
+        if (sign == -1 && result != 0) {
+            result = uint64_t(modulus) - result;
+        }
+        return int(result);
     }
 
     BigInteger operator*=(const int &multiplier) {
-        int add = 0;
-        for (size_t i = 0; i < size; ++i) {
-            long long cur = 1LL * digits[i] * multiplier + add;
-            digits[i] = int(cur % BASE);
-            add = int(cur / BASE);
+        const Limb carry = multiplyAddWord(digits.data(), size(), multiplier < 0 ? Limb(-int64_t(multiplier)) : Limb(multiplier), 0);
+        if (carry > 0) {
+            digits.push_back(carry);
         }
-        digits.push_back(add);
-        while (!digits.empty() && digits.back() == 0) {
-            digits.pop_back();
+        if (multiplier < 0) {
+            sign = -sign;
         }
-        size = digits.size();
+        removeLeadingZeros();
         return *this;
     }
 
     BigInteger &operator/=(const int &divisor) {
-        int residue = 0;
-        for (size_t i = size - 1; i + 1 != 0; --i) {
-            long long cur = digits[i] + 1LL * residue * BASE;
-            digits[i] = int(cur / divisor);
-            residue = int(cur % divisor);
+        divideWord(digits.data(), size(), divisor < 0 ? Limb(-int64_t(divisor)) : Limb(divisor), digits.data());
+        if (divisor < 0) {
+            sign = -sign;
         }
-        while (!digits.empty() && digits.back() == 0) {
-            digits.pop_back();
-        }
-        size = digits.size();
+        removeLeadingZeros();
         return *this;
     }
 
@@ -294,9 +392,24 @@ public:
     friend bool operator<(const BigInteger &first, const BigInteger &second);
     friend class Rational;
     friend bool operator<(const Rational &first, const Rational &second);
+    friend struct GcdMatrix;
+    friend void lehmerReduce(BigInteger &first, BigInteger &second, size_t stop, GcdMatrix *matrix);
+    friend void reduceTop(BigInteger &first, BigInteger &second, size_t shift, GcdMatrix &matrix);
+    friend void halfGcd(const BigInteger &first, const BigInteger &second, BigInteger &reducedFirst,
+                        BigInteger &reducedSecond, GcdMatrix &matrix);
+    friend void reduceToGcd(BigInteger &first, BigInteger &second, GcdMatrix *matrix);
     friend BigInteger GCD(BigInteger first, BigInteger second);
+    friend GcdCofactors gcdCofactors(const BigInteger &first, const BigInteger &second);
+    friend std::pair<BigInteger, BigInteger> divmod(const BigInteger &first, const BigInteger &second);
+    friend BigInteger reciprocal(const BigInteger &value);
+    friend void divideByPower(const BigInteger &number, size_t k, BigInteger &quotient, BigInteger &remainder);
+    friend void writeDecimal(const BigInteger &number, char *last, size_t width);
+    friend BigInteger readDecimal(const char *digits, size_t width);
+    friend std::string decimalString(const BigInteger &number);
 };
 
+static_assert(std::is_nothrow_move_constructible_v<BigInteger> && std::is_nothrow_move_assignable_v<BigInteger>);
+
 BigInteger operator+(const BigInteger &first, const BigInteger &second) {
     BigInteger copy = first;
     copy += second;
@@ -328,15 +441,8 @@ BigInteger operator%(const BigInteger &first, const BigInteger &second) {
 }
 
 bool operator==(const BigInteger &first, const BigInteger &second) {
-    if (first.sign != second.sign || first.size != second.size) {
-        return false;
-    }
-    for (size_t i = 0; i < first.size; ++i) {
-        if (first.digits[i] != second.digits[i]) {
-            return false;
-        }
-    }
-    return true;
+    return first.sign == second.sign &&
+           compareLimbs(first.digits.data(), first.size(), second.digits.data(), second.size()) == 0;
 }
 
 bool operator!=(const BigInteger &first, const BigInteger &second) {
@@ -347,17 +453,8 @@ bool operator<(const BigInteger &first, const BigInteger &second) {
     if (first.sign != second.sign) {
         return first.sign < second.sign;
     }
-    if (first.size != second.size) {
-        return (first.size < second.size && first.sign == 1) ||
-        (first.size > second.size && first.sign == -1);
-    }
-    for (size_t i = first.size - 1; i + 1 != 0; --i) {
-        if (first.digits[i] != second.digits[i]) {
-            return (first.digits[i] < second.digits[i] && first.sign == 1) ||
-            (first.digits[i] > second.digits[i] && first.sign == -1);
-        }
-    }
-    return false;
+    const int order = compareLimbs(first.digits.data(), first.size(), second.digits.data(), second.size());
+    return first.sign == 1 ? order < 0 : order > 0;
 }
 
 bool operator>(const BigInteger &first, const BigInteger &second) {
@@ -372,69 +469,208 @@ bool operator>=(const BigInteger &first, const BigInteger &second) {
     return !(first < second);
 }
 
-BigInteger GCD(BigInteger first, BigInteger second) {
-    BigInteger powOf2 = 1;
-    while (second && first) {
-        bool isDividedFirst = first.digits[0] % 2 == 0;
-        bool isDividedSecond = second.digits[0] % 2 == 0;
-        if (isDividedFirst && isDividedSecond) {
-            first /= 2;
-            second /= 2;
-            powOf2 *= 2;
-        } else if (isDividedFirst) {
-            first /= 2;
-        } else if (isDividedSecond) {
-            second /= 2;
-        } else {
-            first > second ? first -= second : second -= first;
-        }
+// Truncating division: first = quotient * second + remainder, where the
+// remainder has the sign of first and is smaller than second in absolute
+// value. Division by zero gives a zero quotient and the remainder first.
+std::pair<BigInteger, BigInteger> divmod(const BigInteger &first, const BigInteger &second) {
+    std::pair<BigInteger, BigInteger> result;
+    BigInteger &quotient = result.first;
+    BigInteger &remainder = result.second;
+    if (first.size() < second.size() || second.size() == 0) {
+        remainder = first;
+        return result;
     }
-    return first ? first * powOf2 : second * powOf2;
+    quotient.digits.resize(first.size() - second.size() + 1);
+    remainder.digits.resize(second.size());
+    divideLimbs(first.digits.data(), first.size(), second.digits.data(), second.size(),
+                quotient.digits.data(), remainder.digits.data());
+    quotient.sign = first.sign * second.sign;
+    remainder.sign = first.sign;
+    quotient.removeLeadingZeros();
+    remainder.removeLeadingZeros();
+    return result;
 }
 
-std::istream &operator>>(std::istream &in, BigInteger &number) {
-    std::string input;
-    in >> input;
-    number.sign = 1 - 2 * (input[0] == '-');
-    number.digits.clear();
-    for (size_t i = input.size() - 1; i - (number.sign == -1) < input.size(); i -= BASE_CNT) {
-        int digit = 0;
-        size_t begin = i + 1 >= BASE_CNT ? i + 1 - BASE_CNT : 0;
-        begin = std::max(begin, size_t(number.sign == -1));
-        for (size_t j = begin; j <= i; ++j) {
-            digit = digit * 10 + (input[j] - '0');
-        }
-        number.digits.push_back(int(digit));
+// Conversion to and from decimal. Up to DECIMAL_SPLIT_LIMBS limbs the digits
+// are converted DECIMAL_DIGITS at a time; a longer number is split in two
+// halves by a cached power 10^(DECIMAL_DIGITS * 2^k), which costs a few long
+// multiplications, so the whole conversion takes O(M(n) log n).
+const size_t DECIMAL_SPLIT_LIMBS = 40;
+
+// Below this many limbs reciprocals are computed by one long division.
+const size_t RECIPROCAL_THRESHOLD = 60;
+
+// floor(2^(64m) / value) for a positive value of m limbs. Newton's iteration
+// x = 2x - x^2 * value / 2^(64m) is started from the reciprocal of the top
+// m / 2 + 2 limbs, which doubles its m / 2 + 1 correct limbs to more than m;
+// the last units are corrected exactly.
+BigInteger reciprocal(const BigInteger &value) {
+    const size_t m = value.size();
+    const BigInteger limit = BigInteger(1).shiftedLimbs(2 * m);
+    if (m <= RECIPROCAL_THRESHOLD) {
+        return divmod(limit, value).first;
     }
-    number.size = number.digits.size();
-    return in;
+    const size_t h = m / 2 + 2;
+    BigInteger x = reciprocal(value.limbRange(m - h, h)).shiftedLimbs(m - h);
+    const BigInteger square = x * x * value;
+    x += x;
+    x -= square.limbRange(2 * m, square.size());
+    BigInteger rest = limit - x * value;
+    while (rest.sign < 0) {
+        x -= 1;
+        rest += value;
+    }
+    while (rest >= value) {
+        x += 1;
+        rest -= value;
+    }
+    return x;
 }
 
-std::ostream &operator<<(std::ostream &out, const BigInteger &number) {
-    //x0 + x1 * base + x2 * base^2 + x3 * base^3 + ...
-    if (number.size == 0) {
-        out << 0;
-        return out;
+// 10^(DECIMAL_DIGITS * 2^k) and, once a division has asked for it, its
+// reciprocal. Entries are never moved or changed after they are set.
+struct DecimalPower {
+    BigInteger power;
+    BigInteger reciprocal;
+};
+
+const DecimalPower &decimalPower(size_t k, bool withReciprocal = false) {
+    static std::deque<DecimalPower> powers;
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+    if (powers.empty()) {
+        powers.push_back({BigInteger(int(DECIMAL_BASE)), BigInteger()});
     }
-    if (number.sign == -1) {
-        out << '-';
-    }
-    for (size_t i = number.size - 1; i + 1 != 0; --i) {
-        int digit = number.digits[i];
-        int cnt = 0;
-        while (digit > 0) {
-            digit /= 10;
-            ++cnt;
+    while (powers.size() <= k) {
+        powers.push_back({powers.back().power * powers.back().power, BigInteger()});
+    }
+    if (withReciprocal && !powers[k].reciprocal) {
+        powers[k].reciprocal = reciprocal(powers[k].power);
+    }
+    return powers[k];
+}
+
+// 10^exponent from the cached powers.
+BigInteger powerOfTen(size_t exponent) {
+    BigInteger result = 1;
+    for (size_t i = 0; i < exponent % DECIMAL_DIGITS; ++i) {
+        result *= 10;
+    }
+    for (size_t k = 0, blocks = exponent / DECIMAL_DIGITS; blocks > 0; ++k, blocks >>= 1) {
+        if (blocks & 1) {
+            result *= decimalPower(k).power;
         }
-        if (cnt == 0) {
-            cnt = 1;
+    }
+    return result;
+}
+
+// Barrett's division of 0 <= number < P^2 by P = decimalPower(k): with the
+// reciprocal R of P (m limbs) the quotient estimate
+// floor(floor(number / 2^(32(m - 1))) * R / 2^(32(m + 1))) is at most two too small.
+void divideByPower(const BigInteger &number, size_t k, BigInteger &quotient, BigInteger &remainder) {
+    const DecimalPower &power = decimalPower(k, true);
+    const size_t m = power.power.size();
+    const BigInteger estimate = number.limbRange(m - 1, number.size()) * power.reciprocal;
+    quotient = estimate.limbRange(m + 1, estimate.size());
+    remainder = number - quotient * power.power;
+    while (remainder >= power.power) {
+        remainder -= power.power;
+        quotient += 1;
+    }
+}
+
+// Smallest k for which 10^(DECIMAL_DIGITS * 2^k) has at least half of width digits.
+size_t splitLevel(size_t width) {
+    size_t k = 0;
+    while (2 * (DECIMAL_DIGITS << k) < width) {
+        ++k;
+    }
+    return k;
+}
+
+// Writes 0 <= number < 10^width as exactly width digits, with leading zeros,
+// into the width characters before last.
+void writeDecimal(const BigInteger &number, char *last, size_t width) {
+    if (number.size() <= DECIMAL_SPLIT_LIMBS) {
+        std::vector<Limb> rest(number.digits.data(), number.digits.data() + number.size());
+        size_t length = rest.size();
+        char *position = last;
+        while (length > 0) {
+            Limb chunk = divideWord(rest.data(), length, DECIMAL_BASE, rest.data());
+            length = trimmedLength(rest.data(), length);
+            for (size_t i = 0; i < DECIMAL_DIGITS && position != last - width; ++i) {
+                *--position = char('0' + chunk % 10);
+                chunk /= 10;
+            }
         }
-        if (i != number.size - 1) {
-            for (int j = cnt; j < BASE_CNT; ++j) {
-                out << '0';
+        std::fill(last - width, position, '0');
+        return;
+    }
+    const size_t k = splitLevel(width);
+    const size_t low = DECIMAL_DIGITS << k;
+    BigInteger quotient;
+    BigInteger remainder;
+    divideByPower(number, k, quotient, remainder);
+    writeDecimal(remainder, last, low);
+    writeDecimal(quotient, last - low, width - low);
+}
+
+// The number written by the width decimal digits starting at digits.
+BigInteger readDecimal(const char *digits, size_t width) {
+    if (width <= DECIMAL_SPLIT_LIMBS * DECIMAL_DIGITS) {
+        BigInteger result;
+        for (size_t position = 0, end = width % DECIMAL_DIGITS; position < width; end += DECIMAL_DIGITS) {
+            Limb chunk = 0;
+            Limb scale = 1;
+            for (; position < end; ++position) {
+                chunk = chunk * 10 + Limb(digits[position] - '0');
+                scale *= 10;
+            }
+            const Limb carry = multiplyAddWord(result.digits.data(), result.size(), scale, chunk);
+            if (carry > 0) {
+                result.digits.push_back(carry);
             }
         }
-        out << number.digits[i];
+        result.removeLeadingZeros();
+        return result;
+    }
+    const size_t k = splitLevel(width);
+    const size_t low = DECIMAL_DIGITS << k;
+    BigInteger result = readDecimal(digits, width - low) * decimalPower(k).power;
+    result += readDecimal(digits + width - low, low);
+    return result;
+}
+
+// The digits are written right to left into a string of the largest possible
+// length, floor(bits * log10(2)) + 1, and the leading zeros are cut off.
+std::string decimalString(const BigInteger &number) {
+    if (number.size() == 0) {
+        return "0";
+    }
+    const size_t width = number.bitLength() * 30103 / 100000 + 1;
+    std::string result(width + 1, '0');
+    BigInteger magnitude = number;
+    magnitude.sign = 1;
+    writeDecimal(magnitude, &result[0] + result.size(), width);
+    size_t first = result.find_first_not_of('0');
+    if (number.sign == -1) {
+        result[--first] = '-';
+    }
+    return result.substr(first);
+}
+
+std::istream &operator>>(std::istream &in, BigInteger &number) {
+    std::string input;
+    in >> input;
+    const size_t begin = !input.empty() && input[0] == '-' ? 1 : 0;
+    number = readDecimal(input.data() + begin, input.size() - begin);
+    if (begin == 1 && number.size() > 0) {
+        number.sign = -1;
     }
+    return in;
+}
+
+std::ostream &operator<<(std::ostream &out, const BigInteger &number) {
+    out << number.toString();
     return out;
 }
\ No newline at end of file
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include "matrix.h"
+
+// Matrix with dimensions chosen at run time. The entries are stored row-major
+// in one buffer as in Matrix, and every algorithm is the one Matrix uses
+// (kernels.h, matrixalgorithms.h), so the two types only differ in where the
+// dimensions come from. Mismatched dimensions are caught by assert.
+template<typename Field = Rational>
+class DynamicMatrix {
+private:
+    size_t rowCount = 0;
+    size_t columnCount = 0;
+    std::vector<Field> matrix;
+
+    friend struct MatrixAccess;
+
+    DynamicMatrix multiplied(const DynamicMatrix &another, const Field *multiplier) const {
+        assert(columnCount == another.rowCount);
+        LimbPoolScope limbPool;
+        DynamicMatrix result(rowCount, another.columnCount);
+        multiplyKernel(matrix.data(), columnCount, another.matrix.data(), another.columnCount, result.matrix.data(),
+                       another.columnCount, rowCount, columnCount, another.columnCount, multiplier);
+        return result;
+    }
+
+public:
+    DynamicMatrix(size_t rows, size_t columns) : rowCount(rows), columnCount(columns), matrix(rows * columns, Field(0)) {
+        if (rows != columns) {
+            return;
+        }
+        for (size_t i = 0; i < rows; ++i) {
+            matrix[i * columns + i] = Field(1);
+        }
+    }
+
+    DynamicMatrix(const std::vector<std::vector<Field>> &values)
+        : rowCount(values.size()), columnCount(values.empty() ? 0 : values[0].size()) {
+        matrix.reserve(rowCount * columnCount);
+        for (size_t i = 0; i < rowCount; ++i) {
+            assert(values[i].size() == columnCount);
+            matrix.insert(matrix.end(), values[i].begin(), values[i].begin() + columnCount);
+        }
+    }
+
+    DynamicMatrix(const std::initializer_list<std::initializer_list<int>> &values)
+        : rowCount(values.size()), columnCount(values.size() == 0 ? 0 : values.begin()->size()) {
+        matrix.reserve(rowCount * columnCount);
+        for (const std::initializer_list<int> &row : values) {
+            assert(row.size() == columnCount);
+            for (int value : row) {
+                matrix.push_back(Field(value));
+            }
+        }
+    }
+
+    template<size_t N, size_t M>
+    explicit DynamicMatrix(const Matrix<N, M, Field> &another) : rowCount(N), columnCount(M) {
+        matrix.reserve(N * M);
+        for (size_t i = 0; i < N; ++i) {
+            RowView<const Field> row = another[i];
+            matrix.insert(matrix.end(), row.begin(), row.end());
+        }
+    }
+
+    template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+    DynamicMatrix(const Expression &expression)
+        : rowCount(expression.rows()), columnCount(expression.columns()), matrix(rowCount * columnCount, Field(0)) {
+        static_assert(std::is_same_v<typename Expression::Result, DynamicMatrix>);
+        evaluateExpression(expression, matrix.data());
+    }
+
+    template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+    DynamicMatrix &operator=(const Expression &expression) {
+        static_assert(std::is_same_v<typename Expression::Result, DynamicMatrix>);
+        if (rowCount != expression.rows() || columnCount != expression.columns()) {
+            return *this = DynamicMatrix(expression);
+        }
+        evaluateExpression(expression, matrix.data());
+        return *this;
+    }
+
+    size_t rows() const {
+        return rowCount;
+    }
+
+    size_t columns() const {
+        return columnCount;
+    }
+
+    bool operator==(const DynamicMatrix &another) const {
+        return rowCount == another.rowCount && columnCount == another.columnCount && matrix == another.matrix;
+    }
+
+    bool operator!=(const DynamicMatrix &another) const {
+        return !(*this == another);
+    }
+
+    DynamicMatrix &operator+=(const DynamicMatrix &another) {
+        assert(rowCount == another.rowCount && columnCount == another.columnCount);
+        addArrays(matrix.data(), another.matrix.data(), matrix.data(), matrix.size());
+        return *this;
+    }
+
+    DynamicMatrix &operator*=(const Field &multiplier) {
+        scaleArray(matrix.data(), multiplier, matrix.data(), matrix.size());
+        return *this;
+    }
+
+    DynamicMatrix &operator-=(const DynamicMatrix &another) {
+        assert(rowCount == another.rowCount && columnCount == another.columnCount);
+        subtractArrays(matrix.data(), another.matrix.data(), matrix.data(), matrix.size());
+        return *this;
+    }
+
+    template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+    DynamicMatrix &operator+=(const Expression &expression) {
+        return *this = *this + expression;
+    }
+
+    template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+    DynamicMatrix &operator-=(const Expression &expression) {
+        return *this = *this - expression;
+    }
+
+    DynamicMatrix operator*(const DynamicMatrix &another) const {
+        return multiplied(another, nullptr);
+    }
+
+    DynamicMatrix &operator*=(const DynamicMatrix &another) {
+        assert(rowCount == columnCount);
+        *this = *this * another;
+        return *this;
+    }
+
+    RowView<Field> operator[](int i) {
+        return RowView<Field>(matrix.data() + i * columnCount, columnCount);
+    }
+
+    RowView<const Field> operator[](int i) const {
+        return RowView<const Field>(matrix.data() + i * columnCount, columnCount);
+    }
+
+    DynamicMatrix gauss() const {
+        LimbPoolScope limbPool;
+        DynamicMatrix copy = *this;
+        eliminate(copy.matrix.data(), rowCount, columnCount, columnCount);
+        return copy;
+    }
+
+    Field det() const {
+        assert(rowCount == columnCount);
+        return determinant(matrix.data(), rowCount);
+    }
+
+    DynamicMatrix transposed() const {
+        DynamicMatrix result(columnCount, rowCount);
+        transposeArray(matrix.data(), rowCount, columnCount, result.matrix.data());
+        return result;
+    }
+
+    size_t rank() const {
+        return matrixRank(matrix.data(), rowCount, columnCount);
+    }
+
+    Field trace() const {
+        Field result = Field(0);
+        for (size_t i = 0; i < std::min(rowCount, columnCount); ++i) {
+            result += matrix[i * columnCount + i];
+        }
+        return result;
+    }
+
+    std::vector<double> toDouble() const {
+        std::vector<double> result(matrix.size());
+        toDoubles(matrix.data(), rowCount, columnCount, result.data());
+        return result;
+    }
+
+    DynamicMatrix inverted() const {
+        DynamicMatrix result = *this;
+        result.invert();
+        return result;
+    }
+
+    // The matrix must be non-singular.
+    DynamicMatrix &invert() {
+        assert(rowCount == columnCount);
+        [[maybe_unused]] const bool invertible = invertMatrix(matrix.data(), rowCount);
+        assert(invertible && "singular matrix");
+        return *this;
+    }
+
+    RowView<const Field> getRow(unsigned rowNumber) const {
+        return (*this)[rowNumber];
+    }
+
+    ColumnView<const Field> getColumn(unsigned columnNumber) const {
+        return ColumnView<const Field>(matrix.data() + columnNumber, rowCount, columnCount);
+    }
+
+    ColumnView<Field> column(unsigned columnNumber) {
+        return ColumnView<Field>(matrix.data() + columnNumber, rowCount, columnCount);
+    }
+};
+
+template<typename Field>
+DynamicMatrix<Field> pow(const DynamicMatrix<Field> &matrix, const PowerExponent &exponent,
+                         PowerMethod method = PowerMethod::Automatic) {
+    assert(matrix.rows() == matrix.columns());
+    DynamicMatrix<Field> result(matrix.rows(), matrix.rows());
+    matrixPower(MatrixAccess::values(matrix), matrix.rows(), exponent, MatrixAccess::values(result), method);
+    return result;
+}
+
+template<typename Field = Rational>
+std::ostream &operator<<(std::ostream &out, const DynamicMatrix<Field> &matrix) {
+    for (size_t i = 0; i < matrix.rows(); ++i) {
+        for (size_t j = 0; j < matrix.columns(); ++j) {
+            out << int(matrix[i][j]) << ' ';
+        }
+        out << '\n';
+    }
+    return out;
+}
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "biginteger.h"
+
+// GCD of long integers. Lehmer's algorithm runs Euclid's algorithm on the
+// leading 62 bits of both operands (leadingWords) while the quotients are
+// certain to be those of the full operands, and then applies the whole
+// sequence to the full operands with one linear combination. From
+// HALF_GCD_THRESHOLD limbs on, halfGcd finds the quotients that halve the
+// operands recursively from their top halves, so they are applied with a few
+// long multiplications.
+
+const size_t HALF_GCD_THRESHOLD = 120;
+
+// Number of trailing quotients a GcdMatrix keeps at least for reduceTop.
+const size_t GCD_QUOTIENT_HISTORY = 64;
+
+// M = Q(q1) * ... * Q(qk) with Q(q) = [[q, 1], [1, 0]] for quotients q1..qk of
+// Euclid's algorithm, so that (first, second) = M * (a, b) for the remainders
+// a, b they lead to. Once b = 0, first = m00 * a and second = m10 * a.
+struct GcdMatrix {
+    BigInteger m00 = 1;
+    BigInteger m01 = 0;
+    BigInteger m10 = 0;
+    BigInteger m11 = 1;
+    int det = 1;
+    size_t history = GCD_QUOTIENT_HISTORY;
+    std::vector<BigInteger> quotients;
+
+    bool empty() const {
+        return !m01;
+    }
+
+    void remember(const BigInteger &quotient) {
+        if (history == 0) {
+            return;
+        }
+        if (quotients.size() == 2 * history) {
+            quotients.erase(quotients.begin(), quotients.begin() + history);
+        }
+        quotients.push_back(quotient);
+    }
+
+    // M *= Q(quotient).
+    void push(const BigInteger &quotient) {
+        BigInteger next0 = m00 * quotient + m01;
+        BigInteger next1 = m10 * quotient + m11;
+        m01 = std::move(m00);
+        m11 = std::move(m10);
+        m00 = std::move(next0);
+        m10 = std::move(next1);
+        det = -det;
+        remember(quotient);
+    }
+
+    // M *= P for the product P = [[p00, p01], [p10, p11]] of Q(q) over the
+    // given word quotients.
+    void multiply(int64_t p00, int64_t p01, int64_t p10, int64_t p11, const std::vector<int64_t> &steps) {
+        BigInteger next00 = BigInteger::linearCombination(m00, p00, m01, p10);
+        BigInteger next01 = BigInteger::linearCombination(m00, p01, m01, p11);
+        BigInteger next10 = BigInteger::linearCombination(m10, p00, m11, p10);
+        m11 = BigInteger::linearCombination(m10, p01, m11, p11);
+        m00 = std::move(next00);
+        m01 = std::move(next01);
+        m10 = std::move(next10);
+        if (steps.size() % 2 == 1) {
+            det = -det;
+        }
+        for (size_t i = history == 0 ? steps.size() : 0; i < steps.size(); ++i) {
+            remember(BigInteger::fromWord(uint64_t(steps[i])));
+        }
+    }
+
+    void multiply(const GcdMatrix &another) {
+        BigInteger next00 = m00 * another.m00 + m01 * another.m10;
+        BigInteger next01 = m00 * another.m01 + m01 * another.m11;
+        BigInteger next10 = m10 * another.m00 + m11 * another.m10;
+        m11 = m10 * another.m01 + m11 * another.m11;
+        m00 = std::move(next00);
+        m01 = std::move(next01);
+        m10 = std::move(next10);
+        det *= another.det;
+        for (const BigInteger &quotient : another.quotients) {
+            remember(quotient);
+        }
+    }
+
+    // (a, b) = M^-1 * (first, second); M^-1 = det * [[m11, -m01], [-m10, m00]].
+    void reduce(const BigInteger &first, const BigInteger &second, BigInteger &a, BigInteger &b) const {
+        a = m11 * first - m01 * second;
+        b = m00 * second - m10 * first;
+        if (det < 0) {
+            a = -a;
+            b = -b;
+        }
+    }
+
+    // Drops the last remembered quotient q: M *= Q(q)^-1 = [[0, 1], [1, -q]]
+    // and the remainders (a, b) become (q * a + b, a).
+    void pop(BigInteger &a, BigInteger &b) {
+        const BigInteger quotient = std::move(quotients.back());
+        quotients.pop_back();
+        BigInteger previous0 = m00 - quotient * m01;
+        BigInteger previous1 = m10 - quotient * m11;
+        m00 = std::move(m01);
+        m10 = std::move(m11);
+        m01 = std::move(previous0);
+        m11 = std::move(previous1);
+        det = -det;
+        BigInteger previous = quotient * a + b;
+        b = std::move(a);
+        a = std::move(previous);
+    }
+};
+
+// One step of Euclid's algorithm with a long division.
+void euclidStep(BigInteger &first, BigInteger &second, GcdMatrix *matrix) {
+    std::pair<BigInteger, BigInteger> division = divmod(first, second);
+    first = std::move(second);
+    second = std::move(division.second);
+    if (matrix) {
+        matrix->push(division.first);
+    }
+}
+
+// Lehmer's algorithm on first >= second >= 0 while second has more than stop
+// limbs (to the end for stop = 0). Every round is Knuth's Algorithm L: the
+// word quotient is taken only if both bounds of the truncated operands give
+// it, so it is the quotient of the full operands as well.
+void lehmerReduce(BigInteger &first, BigInteger &second, size_t stop, GcdMatrix *matrix) {
+    std::vector<int64_t> steps;
+    while (second.size() > stop) {
+        if (fitsWord(first.digits.data(), first.size())) {
+            if (stop > 0) {
+                euclidStep(first, second, matrix);
+                continue;
+            }
+            int64_t x = wordValue(first.digits.data(), first.size());
+            int64_t y = wordValue(second.digits.data(), second.size());
+            int64_t p00 = 1, p01 = 0, p10 = 0, p11 = 1;
+            steps.clear();
+            while (y != 0) {
+                const int64_t quotient = x / y;
+                int64_t rest = x - quotient * y;
+                x = y;
+                y = rest;
+                rest = p00 * quotient + p01;
+                p01 = p00;
+                p00 = rest;
+                rest = p10 * quotient + p11;
+                p11 = p10;
+                p10 = rest;
+                steps.push_back(quotient);
+            }
+            first = BigInteger::fromWord(uint64_t(x));
+            second = 0;
+            if (matrix) {
+                matrix->multiply(p00, p01, p10, p11, steps);
+            }
+            return;
+        }
+        int64_t u = 0;
+        int64_t v = 0;
+        leadingWords(first.digits.data(), first.size(), second.digits.data(), second.size(), u, v);
+        int64_t a = 1, b = 0, c = 0, d = 1;
+        steps.clear();
+        while (v + c != 0 && v + d != 0) {
+            const int64_t quotient = (u + a) / (v + c);
+            if (quotient != (u + b) / (v + d)) {
+                break;
+            }
+            int64_t rest = a - quotient * c;
+            a = c;
+            c = rest;
+            rest = b - quotient * d;
+            b = d;
+            d = rest;
+            rest = u - quotient * v;
+            u = v;
+            v = rest;
+            steps.push_back(quotient);
+        }
+        if (b == 0) {
+            euclidStep(first, second, matrix);
+            continue;
+        }
+        BigInteger next = BigInteger::linearCombination(first, a, second, b);
+        second = BigInteger::linearCombination(first, c, second, d);
+        first = std::move(next);
+        if (matrix) {
+            // The round maps (first, second) to [[a, b], [c, d]] * (first, second);
+            // its inverse, the product of the Q(q), has the entries |d|, |b|, |c|, |a|.
+            matrix->multiply(d < 0 ? -d : d, b < 0 ? -b : b, c < 0 ? -c : c, a < 0 ? -a : a, steps);
+        }
+    }
+}
+
+void halfGcd(const BigInteger &first, const BigInteger &second, BigInteger &reducedFirst,
+             BigInteger &reducedSecond, GcdMatrix &matrix);
+
+// Reduces first > second >= 0 by the quotients halfGcd finds for their limbs
+// from shift on. These are quotients of the full operands as long as the
+// remainders they give stay ordered; the last ones may be wrong because the
+// low limbs were ignored, so they are dropped until the remainders are ordered.
+void reduceTop(BigInteger &first, BigInteger &second, size_t shift, GcdMatrix &matrix) {
+    BigInteger topFirst;
+    BigInteger topSecond;
+    GcdMatrix top;
+    halfGcd(first.limbRange(shift, first.size()), second.limbRange(shift, second.size()), topFirst, topSecond, top);
+    if (top.empty()) {
+        return;
+    }
+    BigInteger a;
+    BigInteger b;
+    top.reduce(first.limbRange(0, shift), second.limbRange(0, shift), a, b);
+    a += topFirst.shiftedLimbs(shift);
+    b += topSecond.shiftedLimbs(shift);
+    while (b.sign < 0 || a <= b) {
+        if (top.quotients.empty()) {
+            return;
+        }
+        top.pop(a, b);
+    }
+    if (top.empty()) {
+        return;
+    }
+    first = std::move(a);
+    second = std::move(b);
+    matrix.multiply(top);
+}
+
+// Reduces first >= second >= 0 of n limbs along Euclid's algorithm until the
+// smaller remainder has at most n / 2 + 1 limbs; matrix receives the quotients.
+// From HALF_GCD_THRESHOLD limbs on, the top half of the operands is halved
+// recursively (which takes them to about 3n / 4 limbs), then the top half of
+// what is left.
+void halfGcd(const BigInteger &first, const BigInteger &second, BigInteger &reducedFirst,
+             BigInteger &reducedSecond, GcdMatrix &matrix) {
+    const size_t stop = first.size() / 2 + 1;
+    reducedFirst = first;
+    reducedSecond = second;
+    matrix = GcdMatrix();
+    if (second.size() <= stop) {
+        return;
+    }
+    if (first.size() >= HALF_GCD_THRESHOLD) {
+        reduceTop(reducedFirst, reducedSecond, first.size() / 2, matrix);
+        if (reducedSecond.size() > stop) {
+            euclidStep(reducedFirst, reducedSecond, &matrix);
+        }
+        if (reducedSecond.size() > stop) {
+            reduceTop(reducedFirst, reducedSecond, 2 * stop - reducedFirst.size(), matrix);
+        }
+    }
+    lehmerReduce(reducedFirst, reducedSecond, stop, &matrix);
+}
+
+// Runs Euclid's algorithm on first >= second >= 0 to the end: first becomes
+// the GCD, second zero.
+void reduceToGcd(BigInteger &first, BigInteger &second, GcdMatrix *matrix) {
+    while (second.size() >= HALF_GCD_THRESHOLD) {
+        BigInteger reducedFirst;
+        BigInteger reducedSecond;
+        GcdMatrix step;
+        halfGcd(first, second, reducedFirst, reducedSecond, step);
+        if (step.empty()) {
+            euclidStep(first, second, matrix);
+            continue;
+        }
+        first = std::move(reducedFirst);
+        second = std::move(reducedSecond);
+        if (matrix) {
+            matrix->multiply(step);
+        }
+    }
+    lehmerReduce(first, second, 0, matrix);
+}
+
+BigInteger GCD(BigInteger first, BigInteger second) {
+    first.sign = 1;
+    second.sign = 1;
+    if (first < second) {
+        std::swap(first, second);
+    }
+    reduceToGcd(first, second, nullptr);
+    return first;
+}
+
+// gcd = GCD(first, second) together with the cofactors first / gcd and
+// second / gcd, which are read off the quotient matrix instead of dividing.
+// Both cofactors are zero when first and second are.
+struct GcdCofactors {
+    BigInteger gcd;
+    BigInteger first;
+    BigInteger second;
+};
+
+GcdCofactors gcdCofactors(const BigInteger &first, const BigInteger &second) {
+    GcdCofactors result;
+    if (fitsWord(first.digits.data(), first.size()) && fitsWord(second.digits.data(), second.size())) {
+        const int64_t x = wordValue(first.digits.data(), first.size());
+        const int64_t y = wordValue(second.digits.data(), second.size());
+        int64_t gcd = x;
+        int64_t rest = y;
+        while (rest != 0) {
+            gcd %= rest;
+            std::swap(gcd, rest);
+        }
+        if (gcd == 0) {
+            return result;
+        }
+        result.gcd = BigInteger::fromWord(uint64_t(gcd));
+        result.first = BigInteger::fromWord(uint64_t(x / gcd));
+        result.second = BigInteger::fromWord(uint64_t(y / gcd));
+        result.first.sign = first.sign;
+        result.second.sign = second.sign;
+        result.first.removeLeadingZeros();
+        result.second.removeLeadingZeros();
+        return result;
+    }
+    BigInteger a = first < 0 ? -first : first;
+    BigInteger b = second < 0 ? -second : second;
+    const bool swapped = a < b;
+    if (swapped) {
+        std::swap(a, b);
+    }
+    GcdMatrix matrix;
+    matrix.history = 0;
+    reduceToGcd(a, b, &matrix);
+    result.gcd = std::move(a);
+    if (!result.gcd) {
+        return result;
+    }
+    result.first = std::move(swapped ? matrix.m10 : matrix.m00);
+    result.second = std::move(swapped ? matrix.m00 : matrix.m10);
+    if (first < 0) {
+        result.first = -result.first;
+    }
+    if (second < 0) {
+        result.second = -result.second;
+    }
+    return result;
+}
@@ -0,0 +1,532 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "biginteger.h"
+#include "rational.h"
+#include "residue.h"
+#include "bareiss.h"
+#include "simd.h"
+#include "threadpool.h"
+
+template<typename Field>
+struct MultiplyTile {
+    static constexpr size_t columns = 32;
+    static constexpr size_t depth = 128;
+};
+
+template<size_t N>
+struct MultiplyTile<Residue<N>> {
+    static constexpr size_t columns = 64;
+    static constexpr size_t depth = 256;
+};
+
+template<>
+struct MultiplyTile<Rational> {
+    static constexpr size_t columns = 16;
+    static constexpr size_t depth = size_t(-1);
+};
+
+// Rough number of element operations worth handing to another thread.
+template<typename Field>
+struct ParallelGrain {
+    static constexpr size_t operations = 4096;
+};
+
+template<size_t N>
+struct ParallelGrain<Residue<N>> {
+    static constexpr size_t operations = 16384;
+};
+
+template<>
+struct ParallelGrain<Rational> {
+    static constexpr size_t operations = 64;
+};
+
+template<typename Field>
+size_t parallelGrain(size_t operationsPerIndex) {
+    return ParallelGrain<Field>::operations / std::max(operationsPerIndex, size_t(1)) + 1;
+}
+
+// Four independent partial sums keep the additions of consecutive terms from
+// waiting on each other.
+template<typename Field>
+Field dotProduct(const Field *first, const Field *second, size_t length) {
+    Field sum0(0);
+    Field sum1(0);
+    Field sum2(0);
+    Field sum3(0);
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        sum0 += first[i] * second[i];
+        sum1 += first[i + 1] * second[i + 1];
+        sum2 += first[i + 2] * second[i + 2];
+        sum3 += first[i + 3] * second[i + 3];
+    }
+    for (; i < length; ++i) {
+        sum0 += first[i] * second[i];
+    }
+    sum0 += sum1;
+    sum2 += sum3;
+    sum0 += sum2;
+    return sum0;
+}
+
+template<typename Field>
+void addArrays(const Field *x, const Field *y, Field *z, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        z[i] = x[i] + y[i];
+    }
+}
+
+template<typename Field>
+void subtractArrays(const Field *x, const Field *y, Field *z, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        z[i] = x[i] - y[i];
+    }
+}
+
+template<typename Field>
+void scaleArray(const Field *x, const Field &multiplier, Field *z, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        z[i] = x[i] * multiplier;
+    }
+}
+
+template<typename Field>
+Field inverse(const Field &value) {
+    return Field(1) / value;
+}
+
+template<typename Field>
+void invertAll(Field *values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = inverse(values[i]);
+    }
+}
+
+template<size_t N>
+Residue<N> inverse(const Residue<N> &value) {
+    return value.inverse();
+}
+
+template<size_t N>
+void invertAll(Residue<N> *values, size_t count) {
+    Residue<N>::batchInverse(values, count);
+}
+
+template<typename Field>
+void subtractMultiple(Field *row, const Field *another, const Field &multiplier, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        row[i] -= another[i] * multiplier;
+    }
+}
+
+// A Residue is a single reduced int, so arrays of them are handed to the
+// vector kernels of simd.h as arrays of 32-bit words.
+template<size_t N>
+const uint32_t *residueWords(const Residue<N> *values) {
+    static_assert(sizeof(Residue<N>) == sizeof(uint32_t));
+    return reinterpret_cast<const uint32_t *>(values);
+}
+
+template<size_t N>
+uint32_t *residueWords(Residue<N> *values) {
+    static_assert(sizeof(Residue<N>) == sizeof(uint32_t));
+    return reinterpret_cast<uint32_t *>(values);
+}
+
+template<size_t N>
+Residue<N> dotProduct(const Residue<N> *first, const Residue<N> *second, size_t length) {
+    unsigned __int128 sum = 0;
+    if (length >= 16 && dotSimd(residueWords(first), residueWords(second), length, sum)) {
+        return Residue<N>(int(ModularReduction<N>::reduce(sum)));
+    }
+    return Residue<N>::dotProduct(first, second, length);
+}
+
+template<size_t N>
+void addArrays(const Residue<N> *x, const Residue<N> *y, Residue<N> *z, size_t length) {
+    if (!addModularSimd(residueWords(x), residueWords(y), residueWords(z), length, N)) {
+        for (size_t i = 0; i < length; ++i) {
+            z[i] = x[i] + y[i];
+        }
+    }
+}
+
+template<size_t N>
+void subtractArrays(const Residue<N> *x, const Residue<N> *y, Residue<N> *z, size_t length) {
+    if (!subtractModularSimd(residueWords(x), residueWords(y), residueWords(z), length, N)) {
+        for (size_t i = 0; i < length; ++i) {
+            z[i] = x[i] - y[i];
+        }
+    }
+}
+
+template<size_t N>
+void scaleArray(const Residue<N> *x, const Residue<N> &multiplier, Residue<N> *z, size_t length) {
+    if (!scaleModularSimd(residueWords(x), uint32_t(int(multiplier)), residueWords(z), length, N)) {
+        for (size_t i = 0; i < length; ++i) {
+            z[i] = x[i] * multiplier;
+        }
+    }
+}
+
+template<size_t N>
+void subtractMultiple(Residue<N> *row, const Residue<N> *another, const Residue<N> &multiplier, size_t length) {
+    if (!subtractMultipleModularSimd(residueWords(row), residueWords(another), uint32_t(int(multiplier)), length, N)) {
+        for (size_t i = 0; i < length; ++i) {
+            row[i] -= another[i] * multiplier;
+        }
+    }
+}
+
+// Rational sums are reduced once per result instead of after every addition.
+Rational dotProduct(const Rational *first, const Rational *second, size_t length) {
+    RationalAccumulator sum;
+    for (size_t i = 0; i < length; ++i) {
+        sum.addProduct(first[i], second[i]);
+    }
+    return sum.value();
+}
+
+void subtractMultiple(Rational *row, const Rational *another, const Rational &multiplier, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        RationalAccumulator difference;
+        difference.add(row[i]);
+        difference.subtractProduct(another[i], multiplier);
+        row[i] = difference.value();
+    }
+}
+
+// c (n x l) = a (n x m) * b (m x l); lda, ldb and ldc are the row strides.
+// A panel of b of MultiplyTile<Field>::columns columns and ::depth rows is packed
+// column by column once and then reused for every row of a. A multiplier is
+// applied to the entries of b while they are packed.
+template<typename Field>
+void multiplyPanels(const Field *a, size_t lda, const Field *b, size_t ldb, Field *c, size_t ldc,
+                    size_t n, size_t m, size_t l, const Field *multiplier = nullptr) {
+    if (m == 0) {
+        for (size_t i = 0; i < n; ++i) {
+            std::fill(c + i * ldc, c + i * ldc + l, Field(0));
+        }
+        return;
+    }
+    const size_t columnTile = std::min(MultiplyTile<Field>::columns, l);
+    const size_t depthTile = std::min(MultiplyTile<Field>::depth, m);
+    std::vector<Field> panel(columnTile * depthTile, Field(0));
+    for (size_t jj = 0; jj < l; jj += columnTile) {
+        const size_t width = std::min(columnTile, l - jj);
+        for (size_t kk = 0; kk < m; kk += depthTile) {
+            const size_t depth = std::min(depthTile, m - kk);
+            for (size_t k = 0; k < depth; ++k) {
+                const Field *bRow = b + (kk + k) * ldb + jj;
+                for (size_t j = 0; j < width; ++j) {
+                    panel[j * depth + k] = multiplier ? bRow[j] * *multiplier : bRow[j];
+                }
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const Field *aRow = a + i * lda + kk;
+                Field *cRow = c + i * ldc + jj;
+                for (size_t j = 0; j < width; ++j) {
+                    if (kk == 0) {
+                        cRow[j] = dotProduct(aRow, panel.data() + j * depth, depth);
+                    } else {
+                        cRow[j] += dotProduct(aRow, panel.data() + j * depth, depth);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Products with all three dimensions above this threshold are computed by the
+// Strassen-Winograd recursion, smaller ones by the classical kernel.
+size_t &strassenThreshold() {
+    static size_t threshold = 128;
+    return threshold;
+}
+
+void setStrassenThreshold(size_t threshold) {
+    strassenThreshold() = threshold;
+}
+
+template<typename Field>
+void addBlocks(const Field *x, size_t ldx, const Field *y, size_t ldy, Field *z, size_t ldz,
+               size_t rows, size_t columns) {
+    for (size_t i = 0; i < rows; ++i) {
+        addArrays(x + i * ldx, y + i * ldy, z + i * ldz, columns);
+    }
+}
+
+template<typename Field>
+void subtractBlocks(const Field *x, size_t ldx, const Field *y, size_t ldy, Field *z, size_t ldz,
+                    size_t rows, size_t columns) {
+    for (size_t i = 0; i < rows; ++i) {
+        subtractArrays(x + i * ldx, y + i * ldy, z + i * ldz, columns);
+    }
+}
+
+template<typename Field>
+void copyBlock(const Field *x, size_t ldx, Field *z, size_t ldz, size_t rows, size_t columns) {
+    for (size_t i = 0; i < rows; ++i) {
+        std::copy(x + i * ldx, x + i * ldx + columns, z + i * ldz);
+    }
+}
+
+template<typename Field>
+void multiplyKernel(const Field *a, size_t lda, const Field *b, size_t ldb, Field *c, size_t ldc,
+                    size_t n, size_t m, size_t l, const Field *multiplier = nullptr);
+
+// One level of Winograd's variant of Strassen's algorithm (7 products, 15
+// additions) for even n, m and l. The products are written straight into the
+// quadrants of c, so only three half-sized temporaries are needed.
+template<typename Field>
+void strassenEven(const Field *a, size_t lda, const Field *b, size_t ldb, Field *c, size_t ldc,
+                  size_t n, size_t m, size_t l) {
+    const size_t h = n / 2;
+    const size_t p = m / 2;
+    const size_t q = l / 2;
+    const Field *a11 = a;
+    const Field *a12 = a + p;
+    const Field *a21 = a + h * lda;
+    const Field *a22 = a21 + p;
+    const Field *b11 = b;
+    const Field *b12 = b + q;
+    const Field *b21 = b + p * ldb;
+    const Field *b22 = b21 + q;
+    Field *c11 = c;
+    Field *c12 = c + q;
+    Field *c21 = c + h * ldc;
+    Field *c22 = c21 + q;
+    std::vector<Field> x(h * p, Field(0));
+    std::vector<Field> y(p * q, Field(0));
+    std::vector<Field> z(h * q, Field(0));
+
+    subtractBlocks(a11, lda, a21, lda, x.data(), p, h, p);
+    subtractBlocks(b22, ldb, b12, ldb, y.data(), q, p, q);
+    multiplyKernel(x.data(), p, y.data(), q, c21, ldc, h, p, q);
+    addBlocks(a21, lda, a22, lda, x.data(), p, h, p);
+    subtractBlocks(b12, ldb, b11, ldb, y.data(), q, p, q);
+    multiplyKernel(x.data(), p, y.data(), q, c22, ldc, h, p, q);
+    subtractBlocks(x.data(), p, a11, lda, x.data(), p, h, p);
+    subtractBlocks(b22, ldb, y.data(), q, y.data(), q, p, q);
+    multiplyKernel(x.data(), p, y.data(), q, c12, ldc, h, p, q);
+    subtractBlocks(a12, lda, x.data(), p, x.data(), p, h, p);
+    multiplyKernel(x.data(), p, b22, ldb, c11, ldc, h, p, q);
+    multiplyKernel(a11, lda, b11, ldb, z.data(), q, h, p, q);
+
+    addBlocks(c12, ldc, z.data(), q, c12, ldc, h, q);
+    addBlocks(c21, ldc, c12, ldc, c21, ldc, h, q);
+    addBlocks(c12, ldc, c22, ldc, c12, ldc, h, q);
+    addBlocks(c22, ldc, c21, ldc, c22, ldc, h, q);
+    addBlocks(c12, ldc, c11, ldc, c12, ldc, h, q);
+
+    subtractBlocks(y.data(), q, b21, ldb, y.data(), q, p, q);
+    multiplyKernel(a22, lda, y.data(), q, c11, ldc, h, p, q);
+    subtractBlocks(c21, ldc, c11, ldc, c21, ldc, h, q);
+    multiplyKernel(a12, lda, b21, ldb, c11, ldc, h, p, q);
+    addBlocks(c11, ldc, z.data(), q, c11, ldc, h, q);
+}
+
+// Odd dimensions are padded with a zero row or column before the recursion.
+template<typename Field>
+void strassenMultiply(const Field *a, size_t lda, const Field *b, size_t ldb, Field *c, size_t ldc,
+                      size_t n, size_t m, size_t l) {
+    if (n % 2 == 0 && m % 2 == 0 && l % 2 == 0) {
+        strassenEven(a, lda, b, ldb, c, ldc, n, m, l);
+        return;
+    }
+    const size_t paddedN = n + n % 2;
+    const size_t paddedM = m + m % 2;
+    const size_t paddedL = l + l % 2;
+    std::vector<Field> paddedA(paddedN * paddedM, Field(0));
+    std::vector<Field> paddedB(paddedM * paddedL, Field(0));
+    std::vector<Field> paddedC(paddedN * paddedL, Field(0));
+    copyBlock(a, lda, paddedA.data(), paddedM, n, m);
+    copyBlock(b, ldb, paddedB.data(), paddedL, m, l);
+    strassenEven(paddedA.data(), paddedM, paddedB.data(), paddedL, paddedC.data(), paddedL,
+                 paddedN, paddedM, paddedL);
+    copyBlock(paddedC.data(), paddedL, c, ldc, n, l);
+}
+
+// c = a * b (times *multiplier if given), c must not overlap a or b. Blocks of
+// rows of a are multiplied in parallel, every block packs its own panels.
+template<typename Field>
+void multiplyKernel(const Field *a, size_t lda, const Field *b, size_t ldb, Field *c, size_t ldc,
+                    size_t n, size_t m, size_t l, const Field *multiplier) {
+    const size_t threshold = strassenThreshold();
+    if (n > threshold && m > threshold && l > threshold) {
+        strassenMultiply(a, lda, b, ldb, c, ldc, n, m, l);
+        if (multiplier) {
+            for (size_t i = 0; i < n; ++i) {
+                scaleArray(c + i * ldc, *multiplier, c + i * ldc, l);
+            }
+        }
+        return;
+    }
+    const size_t grain = std::max(parallelGrain<Field>(m * l), size_t(8));
+    parallelFor(0, n, grain, [&](size_t from, size_t to) {
+        multiplyPanels(a + from * lda, lda, b, ldb, c + from * ldc, ldc, to - from, m, l, multiplier);
+    });
+}
+
+// Rational products of entries beyond the word-sized form run on integers:
+// every row of a is multiplied by the least common multiple of its
+// denominators and every column of b by that of its own, the integer matrices
+// are multiplied by the BigInteger kernel and every entry of c is divided by
+// its row and column multipliers once. Word-sized entries, and denominators
+// whose multiples would more than double the operands, stay on the fraction
+// kernel. A multiplier is applied to the packed entries of b on the fraction
+// kernel and joins the final division on the integer one.
+void multiplyKernel(const Rational *a, size_t lda, const Rational *b, size_t ldb, Rational *c, size_t ldc,
+                    size_t n, size_t m, size_t l, const Rational *multiplier = nullptr) {
+    size_t fractionLimbs = 0;
+    bool words = true;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < m; ++k) {
+            const size_t limbs = a[i * lda + k].limbs();
+            fractionLimbs += std::max(limbs, size_t(2));
+            words = words && limbs == 0;
+        }
+    }
+    for (size_t k = 0; k < m; ++k) {
+        for (size_t j = 0; j < l; ++j) {
+            const size_t limbs = b[k * ldb + j].limbs();
+            fractionLimbs += std::max(limbs, size_t(2));
+            words = words && limbs == 0;
+        }
+    }
+    if (words) {
+        multiplyKernel<Rational>(a, lda, b, ldb, c, ldc, n, m, l, multiplier);
+        return;
+    }
+    std::vector<BigInteger> integerA(n * m);
+    std::vector<BigInteger> integerB(m * l);
+    std::vector<BigInteger> rowScales(n);
+    std::vector<BigInteger> columnScales(l);
+    parallelFor(0, n, parallelGrain<Rational>(m), [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; ++i) {
+            rowScales[i] = clearDenominators(a + i * lda, m, integerA.data() + i * m);
+        }
+    });
+    parallelFor(0, l, parallelGrain<Rational>(m), [&](size_t from, size_t to) {
+        for (size_t j = from; j < to; ++j) {
+            columnScales[j] = clearDenominators(b + j, m, integerB.data() + j, ldb, l);
+        }
+    });
+    size_t integerLimbs = 0;
+    for (const BigInteger &value : integerA) {
+        integerLimbs += value.limbs();
+    }
+    for (const BigInteger &value : integerB) {
+        integerLimbs += value.limbs();
+    }
+    if (integerLimbs > 2 * fractionLimbs) {
+        multiplyKernel<Rational>(a, lda, b, ldb, c, ldc, n, m, l, multiplier);
+        return;
+    }
+    std::vector<BigInteger> integerC(n * l);
+    multiplyKernel(integerA.data(), m, integerB.data(), l, integerC.data(), l, n, m, l);
+    const BigInteger factorNumerator = multiplier ? multiplier->getNumerator() : BigInteger(1);
+    const BigInteger factorDenominator = multiplier ? multiplier->getDenominator() : BigInteger(1);
+    parallelFor(0, n, parallelGrain<Rational>(l), [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; ++i) {
+            for (size_t j = 0; j < l; ++j) {
+                BigInteger value = std::move(integerC[i * l + j]);
+                BigInteger scale = rowScales[i] * columnScales[j];
+                if (multiplier) {
+                    value *= factorNumerator;
+                    scale *= factorDenominator;
+                }
+                c[i * ldc + j] = scale == 1 ? Rational(value) : Rational(value, scale);
+            }
+        }
+    });
+}
+
+// Forward Gaussian elimination over the first untilColumn columns of the
+// rows x columns matrix in data. A row moved to the pivot position changes its
+// sign, so the determinant is kept. Returns the number of pivots found.
+template<typename Field>
+size_t eliminate(Field *data, size_t rows, size_t columns, size_t untilColumn) {
+    const Field zero(0);
+    size_t k = 0;
+    for (size_t i = 0; i < untilColumn && k < rows; ++i) {
+        size_t j = k;
+        while (j < rows && data[j * columns + i] == zero) {
+            ++j;
+        }
+        if (j == rows) {
+            continue;
+        }
+        if (j != k) {
+            std::swap_ranges(data + j * columns, data + (j + 1) * columns, data + k * columns);
+            for (size_t s = 0; s < columns; ++s) {
+                data[k * columns + s] = zero - data[k * columns + s];
+            }
+        }
+        const Field *pivotRow = data + k * columns;
+        const Field pivotInverse = inverse(pivotRow[i]);
+        const size_t width = columns - i;
+        parallelFor(k + 1, rows, parallelGrain<Field>(width), [&](size_t from, size_t to) {
+            for (size_t t = from; t < to; ++t) {
+                Field *row = data + t * columns;
+                if (row[i] == zero) {
+                    continue;
+                }
+                Field coefficient = row[i] * pivotInverse;
+                subtractMultiple(row + i, pivotRow + i, coefficient, width);
+            }
+        });
+        ++k;
+    }
+    return k;
+}
+
+// Gauss-Jordan inversion of the n x n matrix in data, in place. Column k of
+// the inverse is stored where column k of the matrix is eliminated, so no
+// augmented n x 2n matrix is needed. A row swap is undone at the end by
+// swapping the columns of the inverse, in reverse order. Returns false for a
+// singular matrix, whose entries are then left partly eliminated.
+template<typename Field>
+bool invertInPlace(Field *data, size_t n) {
+    const Field zero(0);
+    std::vector<size_t> swaps(n);
+    for (size_t k = 0; k < n; ++k) {
+        size_t j = k;
+        while (j < n && data[j * n + k] == zero) {
+            ++j;
+        }
+        if (j == n) {
+            return false;
+        }
+        swaps[k] = j;
+        if (j != k) {
+            std::swap_ranges(data + j * n, data + (j + 1) * n, data + k * n);
+        }
+        Field *pivotRow = data + k * n;
+        const Field pivotInverse = inverse(pivotRow[k]);
+        pivotRow[k] = Field(1);
+        scaleArray(pivotRow, pivotInverse, pivotRow, n);
+        parallelFor(0, n, parallelGrain<Field>(n), [&](size_t from, size_t to) {
+            for (size_t t = from; t < to; ++t) {
+                Field *row = data + t * n;
+                if (t == k || row[k] == zero) {
+                    continue;
+                }
+                Field coefficient = row[k];
+                row[k] = zero;
+                subtractMultiple(row, pivotRow, coefficient, n);
+            }
+        });
+    }
+    for (size_t k = n - 1; k + 1 != 0; --k) {
+        if (swaps[k] != k) {
+            for (size_t i = 0; i < n; ++i) {
+                std::swap(data[i * n + k], data[i * n + swaps[k]]);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "limbs.h"
+
+// At most this many limbs are kept in the free lists of one thread.
+const size_t LIMB_POOL_LIMIT = size_t(1) << 22;
+
+// Recycles the heap blocks of LimbBuffers. Heap capacities are powers of two;
+// while a LimbPoolScope is open on a thread, a block freed there is kept in the
+// free list of its size and handed to the next buffer of that size instead of
+// going back to delete[]. All blocks come from new[], so a buffer may outlive
+// the scope or be freed on another thread. The cached blocks are deleted when
+// the outermost scope of the thread closes.
+class LimbPool {
+private:
+    std::vector<Limb *> blocks[8 * sizeof(size_t)];
+    size_t cachedLimbs = 0;
+
+    static size_t &depth() {
+        thread_local size_t depth = 0;
+        return depth;
+    }
+
+    static LimbPool *&local() {
+        thread_local LimbPool *pool = nullptr;
+        return pool;
+    }
+
+    friend class LimbPoolScope;
+
+public:
+    ~LimbPool() {
+        for (std::vector<Limb *> &list : blocks) {
+            for (Limb *block : list) {
+                delete[] block;
+            }
+        }
+    }
+
+    // Limbs held in the free lists of the calling thread.
+    static size_t cached() {
+        return local() ? local()->cachedLimbs : 0;
+    }
+
+    static Limb *allocate(size_t capacity) {
+        LimbPool *pool = local();
+        if (pool) {
+            std::vector<Limb *> &list = pool->blocks[__builtin_ctzll(capacity)];
+            if (!list.empty()) {
+                Limb *block = list.back();
+                list.pop_back();
+                pool->cachedLimbs -= capacity;
+                return block;
+            }
+        }
+        return new Limb[capacity];
+    }
+
+    static void deallocate(Limb *block, size_t capacity) {
+        if (depth() > 0 && capacity <= LIMB_POOL_LIMIT) {
+            LimbPool *&pool = local();
+            if (!pool) {
+                pool = new LimbPool();
+            }
+            if (pool->cachedLimbs + capacity <= LIMB_POOL_LIMIT) {
+                pool->blocks[__builtin_ctzll(capacity)].push_back(block);
+                pool->cachedLimbs += capacity;
+                return;
+            }
+        }
+        delete[] block;
+    }
+};
+
+// Recycles the limb buffers freed on this thread while it is alive. Matrix
+// operations open one for their duration; scopes nest.
+class LimbPoolScope {
+public:
+    LimbPoolScope() {
+        ++LimbPool::depth();
+    }
+
+    LimbPoolScope(const LimbPoolScope &) = delete;
+    LimbPoolScope &operator=(const LimbPoolScope &) = delete;
+
+    ~LimbPoolScope() {
+        if (--LimbPool::depth() == 0) {
+            delete LimbPool::local();
+            LimbPool::local() = nullptr;
+        }
+    }
+};
+
+// Limbs of a BigInteger, least significant first. Numbers of up to
+// INLINE_LIMBS limbs are kept inside the object, so the small values most
+// matrix entries have (Field(0), Field(1), small fractions) never touch the
+// heap; longer numbers spill into a heap array from LimbPool that doubles as it
+// grows and is kept when the number shrinks again.
+class LimbBuffer {
+private:
+    static const size_t INLINE_LIMBS = 2;
+
+    union {
+        Limb local[INLINE_LIMBS];
+        Limb *heap;
+    };
+    size_t length = 0;
+    size_t capacity = INLINE_LIMBS;
+
+    bool isInline() const {
+        return capacity == INLINE_LIMBS;
+    }
+
+    void release() {
+        if (!isInline()) {
+            LimbPool::deallocate(heap, capacity);
+        }
+    }
+
+    void reserve(size_t count) {
+        if (count <= capacity) {
+            return;
+        }
+        size_t grown = 2 * capacity;
+        while (grown < count) {
+            grown *= 2;
+        }
+        Limb *limbs = LimbPool::allocate(grown);
+        std::copy(data(), data() + length, limbs);
+        release();
+        heap = limbs;
+        capacity = grown;
+    }
+
+    void steal(LimbBuffer &another) {
+        length = another.length;
+        capacity = another.capacity;
+        if (another.isInline()) {
+            std::copy(another.local, another.local + INLINE_LIMBS, local);
+        } else {
+            heap = another.heap;
+        }
+        another.length = 0;
+        another.capacity = INLINE_LIMBS;
+    }
+
+public:
+    LimbBuffer() : local{0, 0} {}
+
+    LimbBuffer(const LimbBuffer &another) : local{0, 0} {
+        assign(another.data(), another.data() + another.length);
+    }
+
+    LimbBuffer(LimbBuffer &&another) noexcept : local{0, 0} {
+        steal(another);
+    }
+
+    LimbBuffer &operator=(const LimbBuffer &another) {
+        if (this != &another) {
+            assign(another.data(), another.data() + another.length);
+        }
+        return *this;
+    }
+
+    LimbBuffer &operator=(LimbBuffer &&another) noexcept {
+        if (this != &another) {
+            release();
+            steal(another);
+        }
+        return *this;
+    }
+
+    ~LimbBuffer() {
+        release();
+    }
+
+    Limb *data() {
+        return isInline() ? local : heap;
+    }
+
+    const Limb *data() const {
+        return isInline() ? local : heap;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    bool empty() const {
+        return length == 0;
+    }
+
+    Limb &operator[](size_t i) {
+        return data()[i];
+    }
+
+    const Limb &operator[](size_t i) const {
+        return data()[i];
+    }
+
+    Limb &back() {
+        return data()[length - 1];
+    }
+
+    const Limb &back() const {
+        return data()[length - 1];
+    }
+
+    void push_back(Limb limb) {
+        reserve(length + 1);
+        data()[length++] = limb;
+    }
+
+    void pop_back() {
+        --length;
+    }
+
+    // New limbs are set to value.
+    void resize(size_t count, Limb value = 0) {
+        reserve(count);
+        if (count > length) {
+            std::fill(data() + length, data() + count, value);
+        }
+        length = count;
+    }
+
+    void clear() {
+        length = 0;
+    }
+
+    void assign(const Limb *first, const Limb *last) {
+        const size_t count = size_t(last - first);
+        if (count > capacity) {
+            length = 0;
+            reserve(count);
+        }
+        std::copy(first, last, data());
+        length = count;
+    }
+};
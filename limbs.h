@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "simd.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MATRIX_ADC_X86_64
+#endif
+
+// Kernels on raw limb arrays: a magnitude is stored as its base-2^32 digits,
+// least significant first. Signs and lengths are kept by BigInteger. Carries
+// are shifts, and decimal digits appear only in the conversions of
+// BigInteger, in chunks of DECIMAL_DIGITS digits.
+using Limb = uint32_t;
+const unsigned LIMB_BITS = 32;
+const Limb LIMB_MAX = ~Limb(0);
+
+const Limb DECIMAL_BASE = 1000'000'000;
+const size_t DECIMAL_DIGITS = 9;
+
+// Products whose shorter operand has at least KARATSUBA_THRESHOLD limbs use
+// Karatsuba's method; from TOOM3_THRESHOLD limbs on BigInteger switches to
+// Toom-Cook 3.
+const size_t KARATSUBA_THRESHOLD = 48;
+const size_t TOOM3_THRESHOLD = 250;
+
+// Additions, subtractions and comparisons of at least this many limbs run on
+// the vector kernels of simd.h.
+const size_t SIMD_LIMBS = 32;
+
+size_t trimmedLength(const Limb *a, size_t n) {
+    while (n > 0 && a[n - 1] == 0) {
+        --n;
+    }
+    return n;
+}
+
+// result = a + b + carry over length limbs, two limbs per add-with-carry
+// instruction where it is available. result may coincide with a or b.
+// Returns the carry out.
+Limb addCarry(const Limb *a, const Limb *b, Limb *result, size_t length, Limb carry) {
+    if (length >= SIMD_LIMBS && addLimbsSimd(a, b, result, length, carry)) {
+        return carry;
+    }
+    size_t i = 0;
+#ifdef MATRIX_ADC_X86_64
+    unsigned char flag = carry;
+    for (; i + 2 <= length; i += 2) {
+        unsigned long long x;
+        unsigned long long y;
+        std::memcpy(&x, a + i, sizeof(x));
+        std::memcpy(&y, b + i, sizeof(y));
+        flag = _addcarry_u64(flag, x, y, &x);
+        std::memcpy(result + i, &x, sizeof(x));
+    }
+    carry = flag;
+#endif
+    for (; i < length; ++i) {
+        const uint64_t sum = uint64_t(a[i]) + b[i] + carry;
+        result[i] = Limb(sum);
+        carry = Limb(sum >> LIMB_BITS);
+    }
+    return carry;
+}
+
+// result = a - b - borrow over length limbs; returns the borrow out.
+Limb subtractBorrow(const Limb *a, const Limb *b, Limb *result, size_t length, Limb borrow) {
+    if (length >= SIMD_LIMBS && subtractLimbsSimd(a, b, result, length, borrow)) {
+        return borrow;
+    }
+    size_t i = 0;
+#ifdef MATRIX_ADC_X86_64
+    unsigned char flag = borrow;
+    for (; i + 2 <= length; i += 2) {
+        unsigned long long x;
+        unsigned long long y;
+        std::memcpy(&x, a + i, sizeof(x));
+        std::memcpy(&y, b + i, sizeof(y));
+        flag = _subborrow_u64(flag, x, y, &x);
+        std::memcpy(result + i, &x, sizeof(x));
+    }
+    borrow = flag;
+#endif
+    for (; i < length; ++i) {
+        const uint64_t difference = uint64_t(a[i]) - b[i] - borrow;
+        result[i] = Limb(difference);
+        borrow = Limb(difference >> 63);
+    }
+    return borrow;
+}
+
+// a += b, where a has n >= m limbs. Returns the carry out of a[n - 1].
+Limb addLimbs(Limb *a, size_t n, const Limb *b, size_t m) {
+    Limb carry = addCarry(a, b, a, m, 0);
+    for (size_t i = m; carry && i < n; ++i) {
+        carry = ++a[i] == 0;
+    }
+    return carry;
+}
+
+// a -= b, where a has n >= m limbs and a >= b.
+void subtractLimbs(Limb *a, size_t n, const Limb *b, size_t m) {
+    Limb borrow = subtractBorrow(a, b, a, m, 0);
+    for (size_t i = m; borrow && i < n; ++i) {
+        borrow = a[i]-- == 0;
+    }
+}
+
+// Compares the magnitudes a (n limbs) and b (m limbs) without leading zeros;
+// returns -1, 0 or 1.
+int compareLimbs(const Limb *a, size_t n, const Limb *b, size_t m) {
+    if (n != m) {
+        return n < m ? -1 : 1;
+    }
+    int order = 0;
+    if (n >= SIMD_LIMBS && compareLimbsSimd(a, b, n, order)) {
+        return order;
+    }
+    for (size_t i = n; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// a = a * multiplier + addend; returns the limb carried out of a[n - 1].
+Limb multiplyAddWord(Limb *a, size_t n, Limb multiplier, Limb addend) {
+    uint64_t carry = addend;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t current = uint64_t(a[i]) * multiplier + carry;
+        a[i] = Limb(current);
+        carry = current >> LIMB_BITS;
+    }
+    return Limb(carry);
+}
+
+// quotient = a / divisor for a of n limbs; quotient may coincide with a.
+// Returns the remainder.
+Limb divideWord(const Limb *a, size_t n, Limb divisor, Limb *quotient) {
+    uint64_t rest = 0;
+    for (size_t i = n; i-- > 0;) {
+        const uint64_t current = (rest << LIMB_BITS) | a[i];
+        quotient[i] = Limb(current / divisor);
+        rest = current % divisor;
+    }
+    return Limb(rest);
+}
+
+// result (n + m limbs) = a * b, one row of b per limb of a. A column never
+// overflows: (2^32 - 1)^2 plus two limbs is 2^64 - 1.
+void multiplySchoolbook(const Limb *a, size_t n, const Limb *b, size_t m, Limb *result) {
+    std::fill(result, result + n + m, 0);
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t digit = a[i];
+        Limb *row = result + i;
+        uint64_t carry = 0;
+        for (size_t j = 0; j < m; ++j) {
+            const uint64_t current = digit * b[j] + row[j] + carry;
+            row[j] = Limb(current);
+            carry = current >> LIMB_BITS;
+        }
+        row[m] = Limb(carry);
+    }
+}
+
+void multiplyLimbs(const Limb *a, size_t n, const Limb *b, size_t m, Limb *result);
+
+// One level of Karatsuba for m <= n < 2m: with a = a1 * 2^(32h) + a0 and
+// b = b1 * 2^(32h) + b0 the middle product is (a0 + a1)(b0 + b1) - a0b0 - a1b1.
+void multiplyKaratsuba(const Limb *a, size_t n, const Limb *b, size_t m, Limb *result) {
+    const size_t h = n / 2;
+    multiplyLimbs(a, h, b, h, result);
+    multiplyLimbs(a + h, n - h, b + h, m - h, result + 2 * h);
+
+    std::vector<Limb> sumA(n - h + 1, 0);
+    std::vector<Limb> sumB(std::max(h, m - h) + 1, 0);
+    std::copy(a + h, a + n, sumA.begin());
+    sumA[n - h] = addLimbs(sumA.data(), n - h, a, h);
+    std::copy(b, b + h, sumB.begin());
+    sumB.back() = addLimbs(sumB.data(), sumB.size() - 1, b + h, m - h);
+    const size_t lengthA = trimmedLength(sumA.data(), sumA.size());
+    const size_t lengthB = trimmedLength(sumB.data(), sumB.size());
+
+    std::vector<Limb> middle(sumA.size() + sumB.size(), 0);
+    multiplyLimbs(sumA.data(), lengthA, sumB.data(), lengthB, middle.data());
+    subtractLimbs(middle.data(), middle.size(), result, 2 * h);
+    subtractLimbs(middle.data(), middle.size(), result + 2 * h, n + m - 2 * h);
+    addLimbs(result + h, n + m - h, middle.data(), trimmedLength(middle.data(), middle.size()));
+}
+
+// result (n + m limbs) = a * b. A much longer operand is cut into pieces of
+// the length of the shorter one, so that Karatsuba always gets balanced halves.
+void multiplyLimbs(const Limb *a, size_t n, const Limb *b, size_t m, Limb *result) {
+    if (n < m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    if (m == 0) {
+        std::fill(result, result + n, 0);
+        return;
+    }
+    if (m < KARATSUBA_THRESHOLD) {
+        multiplySchoolbook(a, n, b, m, result);
+        return;
+    }
+    if (n >= 2 * m) {
+        std::fill(result, result + n + m, 0);
+        std::vector<Limb> product(2 * m);
+        for (size_t offset = 0; offset < n; offset += m) {
+            const size_t length = std::min(m, n - offset);
+            multiplyLimbs(a + offset, length, b, m, product.data());
+            addLimbs(result + offset, n + m - offset, product.data(), length + m);
+        }
+        return;
+    }
+    multiplyKaratsuba(a, n, b, m, result);
+}
+
+// Knuth's Algorithm D: quotient (n - m + 1 limbs) and remainder (m limbs) of
+// u (n limbs) by v (m limbs), where n >= m and v[m - 1] != 0. Both operands are
+// shifted left until the top bit of the divisor is set; then the quotient
+// limb estimated from the top two limbs is at most two too large.
+void divideLimbs(const Limb *u, size_t n, const Limb *v, size_t m, Limb *quotient, Limb *remainder) {
+    if (m == 1) {
+        remainder[0] = divideWord(u, n, v[0], quotient);
+        return;
+    }
+    const unsigned shift = unsigned(__builtin_clz(v[m - 1]));
+    std::vector<Limb> un(n + 1);
+    std::vector<Limb> vn(m);
+    for (size_t i = m; i-- > 1;) {
+        vn[i] = shift ? (v[i] << shift) | (v[i - 1] >> (LIMB_BITS - shift)) : v[i];
+    }
+    vn[0] = v[0] << shift;
+    un[n] = shift ? u[n - 1] >> (LIMB_BITS - shift) : 0;
+    for (size_t i = n; i-- > 1;) {
+        un[i] = shift ? (u[i] << shift) | (u[i - 1] >> (LIMB_BITS - shift)) : u[i];
+    }
+    un[0] = u[0] << shift;
+
+    const uint64_t top = vn[m - 1];
+    const uint64_t next = vn[m - 2];
+    for (size_t j = n - m + 1; j-- > 0;) {
+        const uint64_t head = (uint64_t(un[j + m]) << LIMB_BITS) | un[j + m - 1];
+        uint64_t estimate = head / top;
+        uint64_t rest = head % top;
+        while (rest >> LIMB_BITS == 0 &&
+               (estimate >> LIMB_BITS != 0 || estimate * next > ((rest << LIMB_BITS) | un[j + m - 2]))) {
+            --estimate;
+            rest += top;
+        }
+        uint64_t productCarry = 0;
+        Limb borrow = 0;
+        for (size_t i = 0; i < m; ++i) {
+            const uint64_t product = estimate * vn[i] + productCarry;
+            productCarry = product >> LIMB_BITS;
+            const uint64_t digit = uint64_t(un[i + j]) - Limb(product) - borrow;
+            un[i + j] = Limb(digit);
+            borrow = Limb(digit >> 63);
+        }
+        const int64_t digit = int64_t(un[j + m]) - int64_t(productCarry) - borrow;
+        un[j + m] = Limb(digit);
+        if (digit < 0) {
+            --estimate;
+            addLimbs(un.data() + j, m + 1, vn.data(), m);
+        }
+        quotient[j] = Limb(estimate);
+    }
+
+    for (size_t i = 0; i < m; ++i) {
+        remainder[i] = shift ? (un[i] >> shift) | (un[i + 1] << (LIMB_BITS - shift)) : un[i];
+    }
+}
+
+// Whether a number of n limbs is below 2^63, so that wordValue can take it.
+bool fitsWord(const Limb *a, size_t n) {
+    return n < 2 || (n == 2 && a[1] >> (LIMB_BITS - 1) == 0);
+}
+
+// Value of a number below 2^63 (at most two limbs).
+int64_t wordValue(const Limb *a, size_t n) {
+    return n == 0 ? 0 : n == 1 ? int64_t(a[0]) : int64_t((uint64_t(a[1]) << LIMB_BITS) | a[0]);
+}
+
+// u / S and v / S rounded down for the S = 2^k that leaves 62 bits of u, where
+// u does not fit a word (fitsWord) and v has at most n limbs. Lehmer's
+// algorithm runs Euclid's algorithm on these two words.
+void leadingWords(const Limb *u, size_t n, const Limb *v, size_t m, int64_t &uHead, int64_t &vHead) {
+    unsigned __int128 uTop = 0;
+    unsigned __int128 vTop = 0;
+    for (size_t i = n; i-- > (n > 3 ? n - 3 : 0);) {
+        uTop = (uTop << LIMB_BITS) | u[i];
+        vTop = (vTop << LIMB_BITS) | (i < m ? v[i] : 0u);
+    }
+    int shift = 0;
+    while ((uTop >> shift) >> 62 != 0) {
+        ++shift;
+    }
+    uHead = int64_t(uTop >> shift);
+    vHead = int64_t(vTop >> shift);
+}
+
+// result = x * a + y * b for |x|, |y| < 2^63, where the result is known to be
+// non-negative and result has at least max(n, m) + 3 limbs. The signed carry
+// is shifted arithmetically, which rounds it down like the limbs it leaves.
+void combineLimbs(const Limb *a, size_t n, int64_t x, const Limb *b, size_t m, int64_t y, Limb *result,
+                  size_t length) {
+    __int128 carry = 0;
+    for (size_t i = 0; i < length; ++i) {
+        __int128 current = carry;
+        if (i < n) {
+            current += __int128(x) * a[i];
+        }
+        if (i < m) {
+            current += __int128(y) * b[i];
+        }
+        result[i] = Limb(current);
+        carry = current >> LIMB_BITS;
+    }
+}
@@ -1,42 +1,98 @@
+#pragma once
+
+#include <cassert>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <type_traits>
 #include "biginteger.h"
 #include "rational.h"
 #include "residue.h"
+#include "matrixview.h"
+#include "kernels.h"
+#include "matrixalgorithms.h"
+#include "matrixexpression.h"
+#include "matrixpower.h"
+
+template<size_t N, typename Field>
+class PLU;
 
 template<size_t N, size_t M, typename Field = Rational>
 class Matrix {
 private:
-    std::vector<std::vector<Field>> matrix;
+    std::vector<Field> matrix;
+
+    template<size_t K, size_t L, typename AnotherField>
+    friend class Matrix;
+
+    template<size_t K, typename AnotherField>
+    friend class PLU;
+
+    friend struct MatrixAccess;
+
+    // this * another * (*multiplier); no scaling when multiplier is null.
+    template<size_t K, size_t L>
+    Matrix<N, L, Field> multiplied(const Matrix<K, L, Field> &another, const Field *multiplier) const {
+        static_assert(M == K);
+        LimbPoolScope limbPool;
+        Matrix<N, L, Field> result;
+        multiplyKernel(matrix.data(), M, another.matrix.data(), L, result.matrix.data(), L, N, M, L, multiplier);
+        return result;
+    }
 
 public:
-    Matrix() : matrix(N, std::vector<Field>(M, Field(0))) {
+    Matrix() : matrix(N * M, Field(0)) {
         if (N != M) {
             return;
         }
         for (size_t i = 0; i < N; ++i) {
-            matrix[i][i] = Field(1);
+            matrix[i * M + i] = Field(1);
         }
     }
 
-    Matrix(const std::vector<std::vector<Field>> &values) : matrix(values) {}
+    Matrix(const std::vector<std::vector<Field>> &values) {
+        matrix.reserve(N * M);
+        for (size_t i = 0; i < N; ++i) {
+            matrix.insert(matrix.end(), values[i].begin(), values[i].begin() + M);
+        }
+    }
 
     Matrix(const std::initializer_list<std::initializer_list<int>> &values) {
-        matrix.resize(N);
+        matrix.reserve(N * M);
         auto row = values.begin();
         for (size_t i = 0; i < N; ++i) {
             auto elem = (*row).begin();
             for (size_t j = 0; j < M; ++j) {
-                matrix[i].push_back(Field(*elem));
+                matrix.push_back(Field(*elem));
                 ++elem;
             }
             ++row;
         }
     }
 
+    template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+    Matrix(const Expression &expression) : matrix(N * M, Field(0)) {
+        static_assert(std::is_same_v<typename Expression::Result, Matrix>);
+        evaluateExpression(expression, matrix.data());
+    }
+
+    // Entry i of the result depends on entry i of the operands only, so the
+    // matrix itself may appear in the expression.
+    template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+    Matrix &operator=(const Expression &expression) {
+        static_assert(std::is_same_v<typename Expression::Result, Matrix>);
+        evaluateExpression(expression, matrix.data());
+        return *this;
+    }
+
     template<size_t K, size_t L>
     bool operator==(const Matrix<K, L, Field> &another) const {
-        return matrix == another.matrix;
+        // The flat storage of a K x L matrix matches that of an L x K one.
+        if constexpr (N == K && M == L) {
+            return matrix == another.matrix;
+        } else {
+            return false;
+        }
     }
 
     template<size_t K, size_t L>
@@ -47,71 +103,35 @@ public:
     template<size_t K, size_t L>
     Matrix &operator+=(const Matrix<K, L, Field> &another) {
         static_assert(N == K && M == L);
-        for (size_t i = 0; i < N; ++i) {
-            std::vector<Field> rowAnother = another[i];
-            for (size_t j = 0; j < M; ++j) {
-                matrix[i][j] += rowAnother[j];
-            }
-        }
+        addArrays(matrix.data(), another.matrix.data(), matrix.data(), N * M);
         return *this;
     }
 
     Matrix &operator*=(const Field &multiplier) {
-        for (size_t i = 0; i < N; ++i) {
-            for (size_t j = 0; j < M; ++j) {
-                matrix[i][j] *= multiplier;
-            }
-        }
+        scaleArray(matrix.data(), multiplier, matrix.data(), N * M);
         return *this;
     }
 
     template<size_t K, size_t L>
     Matrix &operator-=(const Matrix<K, L, Field> &another) {
-        for (size_t i = 0; i < N; ++i) {
-            std::vector<Field> rowAnother = another[i];
-            for (size_t j = 0; j < M; ++j) {
-                matrix[i][j] -= rowAnother[j];
-            }
-        }
+        static_assert(N == K && M == L);
+        subtractArrays(matrix.data(), another.matrix.data(), matrix.data(), N * M);
         return *this;
     }
 
-    template<size_t K, size_t L>
-    Matrix operator+(const Matrix<K, L, Field> &another) const {
-        Matrix result = *this;
-        result += another;
-        return result;
+    template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+    Matrix &operator+=(const Expression &expression) {
+        return *this = *this + expression;
     }
 
-    template<size_t K, size_t L>
-    Matrix operator-(const Matrix<K, L, Field> &another) const {
-        Matrix result = *this;
-        result -= another;
-        return result;
-    }
-
-    template<size_t K, size_t L>
-    Matrix operator*(const Field &multiplier) const {
-        Matrix result = *this;
-        result *= multiplier;
-        return result;
+    template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+    Matrix &operator-=(const Expression &expression) {
+        return *this = *this - expression;
     }
 
     template<size_t K, size_t L>
     Matrix<N, L, Field> operator*(const Matrix<K, L, Field> &another) const {
-        static_assert(M == K);
-        Matrix<N, L, Field> result;
-        for (size_t i = 0; i < N; ++i) {
-            std::vector<Field> row(L, Field(0));
-            for (size_t j = 0; j < L; ++j) {
-                std::vector<Field> anotherColumn = another.getColumn(j);
-                for (size_t k = 0; k < M; ++k) {
-                    row[j] += matrix[i][k] * anotherColumn[k];
-                }
-            }
-            result[i] = row;
-        }
-        return result;
+        return multiplied(another, nullptr);
     }
 
     template<size_t K, size_t L>
@@ -121,143 +141,92 @@ public:
         return *this;
     }
 
-    std::vector<Field> &operator[](int i) {
-        return matrix[i];
+    RowView<Field> operator[](int i) {
+        return RowView<Field>(matrix.data() + i * M, M);
     }
 
-    std::vector<Field> operator[](int i) const {
-        return matrix[i];
+    RowView<const Field> operator[](int i) const {
+        return RowView<const Field>(matrix.data() + i * M, M);
     }
 
     Matrix gauss(bool forInverting = false) const {
+        LimbPoolScope limbPool;
         Matrix copy = *this;
-        size_t k = 0;
-        size_t untilColumn = M;
-        if (forInverting) {
-            untilColumn /= 2;
-        }
-        for (size_t i = 0; i < untilColumn; ++i) {
-            size_t j = k;
-            while (j < N && copy.matrix[j][i] == Field(0)) {
-                ++j;
-            }
-            if (j == N) {
-                continue;
-            }
-            swap(copy.matrix[j], copy.matrix[k]);
-            for (size_t t = k + 1; t < N; ++t) {
-                Field coefficient = copy.matrix[t][i] / copy.matrix[k][i];
-                for (size_t s = i; s < M; ++s) {
-                    copy.matrix[t][s] -= copy.matrix[i][s] * coefficient;
-                }
-            }
-            ++k;
-        }
+        eliminate(copy.matrix.data(), N, M, forInverting ? M / 2 : M);
         return copy;
     }
 
     Matrix invertedGauss() const {
         Matrix result = *this;
         for (size_t c = M / 2 - 1; c + 1 != 0; --c) {
-            for (size_t i = 0; i < c; ++i) {
-                Field coefficient = result.matrix[i][c] / result.matrix[c][c];
-                for (size_t j = c; j < M; ++j) {
-                    result.matrix[i][j] -= coefficient * result.matrix[c][j];
+            const Field *pivotRow = result.matrix.data() + c * M;
+            const Field pivotInverse = inverse(pivotRow[c]);
+            parallelFor(0, c, parallelGrain<Field>(M - c), [&](size_t from, size_t to) {
+                for (size_t i = from; i < to; ++i) {
+                    Field *row = result.matrix.data() + i * M;
+                    Field coefficient = row[c] * pivotInverse;
+                    subtractMultiple(row + c, pivotRow + c, coefficient, M - c);
                 }
-            }
+            });
         }
         return result;
     }
 
     Field det() const {
         static_assert(N == M);
-        Matrix copy = gauss();
-        Field det = Field(1);
-        for (size_t i = 0; i < N; ++i) {
-            det *= copy.matrix[i][i];
-        }
-        return det;
+        return determinant(matrix.data(), N);
     }
 
     Matrix<M, N, Field> transposed() const {
         Matrix<M, N, Field> result;
-        for (size_t i = 0; i < M; ++i) {
-            result[i] = getColumn(i);
-        }
+        transposeArray(matrix.data(), N, M, result.matrix.data());
         return result;
     }
 
     size_t rank() const {
-        Matrix copy = gauss();
-        size_t j = 0;
-        size_t answer = 0;
-        for (size_t i = 0; i < N; ++i) {
-            while (j < M && copy.matrix[i][j] == Field(0)) {
-                ++j;
-            }
-            if (j >= M) {
-                break;
-            }
-            ++answer;
-        }
-        return answer;
+        return matrixRank(matrix.data(), N, M);
     }
 
     Field trace() const {
         Field result = Field(0);
         for (size_t i = 0; i < std::min(N, M); ++i) {
-            result += matrix[i][i];
+            result += matrix[i * M + i];
         }
         return result;
     }
 
+    // Entries as doubles, row by row, for handing the matrix to floating-point
+    // code. Rational entries are rounded correctly.
+    std::vector<double> toDouble() const {
+        std::vector<double> result(N * M);
+        toDoubles(matrix.data(), N, M, result.data());
+        return result;
+    }
+
     Matrix inverted() const {
-        static_assert(N == M);
-        Matrix<N, 2 * N, Field> copy;
-        for (size_t i = 0; i < N; ++i) {
-            std::vector<Field> row = matrix[i];
-            for (size_t j = 0; j < N; ++j) {
-                row.push_back(Field(0));
-                if (j == i) {
-                    row.back() = Field(1);
-                }
-            }
-            copy[i] = row;
-        }
-        copy = copy.gauss();
-        for (size_t i = 0; i < N; ++i) {
-            std::vector<Field> row = copy[i];
-            for (size_t j = i + 1; j < 2 * N; ++j) {
-                row[j] = row[j] / row[i];
-            }
-            row[i] = Field(1);
-            copy[i] = row;
-        }
-        copy = copy.invertedGauss();
-        Matrix result;
-        for (size_t i = 0; i < N; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                result[i][j] = copy[i][j + N];
-            }
-        }
+        Matrix result = *this;
+        result.invert();
         return result;
     }
 
+    // The matrix must be non-singular.
     Matrix &invert() {
-        *this = inverted();
+        static_assert(N == M);
+        [[maybe_unused]] const bool invertible = invertMatrix(matrix.data(), N);
+        assert(invertible && "singular matrix");
         return *this;
     }
 
-    std::vector<Field> getRow(unsigned rowNumber) const {
-        return matrix[rowNumber];
+    RowView<const Field> getRow(unsigned rowNumber) const {
+        return (*this)[rowNumber];
     }
 
-    std::vector<Field> getColumn(unsigned columnNumber) const {
-        std::vector<Field> result;
-        for (size_t i = 0; i < N; ++i) {
-            result.push_back(matrix[i][columnNumber]);
-        }
-        return result;
+    ColumnView<const Field> getColumn(unsigned columnNumber) const {
+        return ColumnView<const Field>(matrix.data() + columnNumber, N, M);
+    }
+
+    ColumnView<Field> column(unsigned columnNumber) {
+        return ColumnView<Field>(matrix.data() + columnNumber, N, M);
     }
 };
 
@@ -275,9 +244,12 @@ std::ostream &operator<<(std::ostream &out, const Matrix<N, M, Field> &matrix) {
 template<size_t N, typename Field = Rational>
 using SquareMatrix = Matrix<N, N, Field>;
 
-template<size_t N, size_t M, typename Field = Rational>
-Matrix<N, M, Field> operator*(const Field &multiplier, const Matrix<N, M, Field> &matrix) {
-    Matrix<N, M, Field> result = matrix;
-    result *= multiplier;
+// matrix^exponent for a long long or BigInteger exponent (matrixpower.h); a
+// negative exponent raises the inverse.
+template<size_t N, typename Field>
+SquareMatrix<N, Field> pow(const SquareMatrix<N, Field> &matrix, const PowerExponent &exponent,
+                           PowerMethod method = PowerMethod::Automatic) {
+    SquareMatrix<N, Field> result;
+    matrixPower(MatrixAccess::values(matrix), N, exponent, MatrixAccess::values(result), method);
     return result;
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <type_traits>
+#include "biginteger.h"
+#include "rational.h"
+#include "residue.h"
+#include "kernels.h"
+#include "bareiss.h"
+#include "multimodular.h"
+
+// The algorithms behind det(), rank(), invert() and toDouble() of Matrix and
+// DynamicMatrix, on row-major arrays, so both matrix types run the same code.
+
+template<typename Field>
+Field determinant(const Field *data, size_t n) {
+    LimbPoolScope limbPool;
+    if constexpr (std::is_same_v<Field, Rational>) {
+        return n >= MULTI_MODULAR_THRESHOLD ? multiModularDet(data, n) : bareissDet(data, n);
+    } else {
+        std::vector<Field> copy(data, data + n * n);
+        eliminate(copy.data(), n, n, n);
+        Field det = Field(1);
+        for (size_t i = 0; i < n; ++i) {
+            det *= copy[i * n + i];
+        }
+        return det;
+    }
+}
+
+template<typename Field>
+size_t matrixRank(const Field *data, size_t rows, size_t columns) {
+    LimbPoolScope limbPool;
+    if constexpr (std::is_same_v<Field, Rational>) {
+        if (std::min(rows, columns) >= MULTI_MODULAR_THRESHOLD) {
+            return multiModularRank(data, rows, columns);
+        }
+        return bareissRank(data, rows, columns);
+    } else {
+        std::vector<Field> copy(data, data + rows * columns);
+        return eliminate(copy.data(), rows, columns, columns);
+    }
+}
+
+// False for a singular matrix, whose entries are then unspecified.
+template<typename Field>
+bool invertMatrix(Field *data, size_t n) {
+    LimbPoolScope limbPool;
+    if constexpr (std::is_same_v<Field, Rational>) {
+        return bareissInverse(data, n, data);
+    } else {
+        return invertInPlace(data, n);
+    }
+}
+
+// Rational entries are rounded correctly.
+template<typename Field>
+void toDoubles(const Field *data, size_t rows, size_t columns, double *result) {
+    parallelFor(0, rows, parallelGrain<Field>(columns), [&](size_t from, size_t to) {
+        for (size_t i = from * columns; i < to * columns; ++i) {
+            if constexpr (std::is_same_v<Field, Rational>) {
+                result[i] = double(data[i]);
+            } else {
+                result[i] = double(int(data[i]));
+            }
+        }
+    });
+}
+
+template<typename Field>
+void transposeArray(const Field *data, size_t rows, size_t columns, Field *result) {
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < columns; ++j) {
+            result[j * rows + i] = data[i * columns + j];
+        }
+    }
+}
@@ -0,0 +1,612 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "rational.h"
+#include "kernels.h"
+#include "threadpool.h"
+
+// Lazy elementwise arithmetic. A + B, A - B, c * A and A * c build small
+// expression objects that refer to their matrices instead of computing new
+// matrices; the whole expression is evaluated in one pass when it is assigned
+// to a matrix or used to construct one. Every entry is a linear combination
+// of entries of the operands. Over Rational it is summed by a
+// RationalAccumulator and reduced once, not after every operator; other fields
+// go through the array kernels (the vector ones for Residue) block by block,
+// so the destination block stays in cache. An expression refers to the named
+// matrices it was built from and must be evaluated while they exist; a
+// temporary matrix, such as a product, is moved into the expression.
+
+template<size_t N, size_t M, typename Field>
+class Matrix;
+
+template<typename Field>
+class DynamicMatrix;
+
+template<typename T>
+struct MatrixTraits {
+    static constexpr bool isMatrix = false;
+};
+
+template<size_t N, size_t M, typename EntryField>
+struct MatrixTraits<Matrix<N, M, EntryField>> {
+    static constexpr bool isMatrix = true;
+    using Field = EntryField;
+
+    static size_t rows(const Matrix<N, M, EntryField> &) {
+        return N;
+    }
+
+    static size_t columns(const Matrix<N, M, EntryField> &) {
+        return M;
+    }
+};
+
+template<typename EntryField>
+struct MatrixTraits<DynamicMatrix<EntryField>> {
+    static constexpr bool isMatrix = true;
+    using Field = EntryField;
+
+    static size_t rows(const DynamicMatrix<EntryField> &matrix) {
+        return matrix.rows();
+    }
+
+    static size_t columns(const DynamicMatrix<EntryField> &matrix) {
+        return matrix.columns();
+    }
+};
+
+// The private parts of Matrix and DynamicMatrix used by free functions.
+struct MatrixAccess {
+    template<typename Source>
+    static auto values(const Source &matrix) {
+        return matrix.matrix.data();
+    }
+
+    template<typename Source>
+    static auto values(Source &matrix) {
+        return matrix.matrix.data();
+    }
+
+    // left * right * (*multiplier), the multiplier applied inside the kernel.
+    template<typename Left, typename Right, typename Field>
+    static auto product(const Left &left, const Right &right, const Field *multiplier) {
+        return left.multiplied(right, multiplier);
+    }
+};
+
+template<typename Field>
+class FieldSum {
+private:
+    Field sum = Field(0);
+
+public:
+    void add(const Field &value) {
+        sum += value;
+    }
+
+    void subtract(const Field &value) {
+        sum -= value;
+    }
+
+    void addProduct(const Field &first, const Field &second) {
+        sum += first * second;
+    }
+
+    void subtractProduct(const Field &first, const Field &second) {
+        sum -= first * second;
+    }
+
+    Field value() const {
+        return sum;
+    }
+};
+
+template<typename Field>
+struct EntrySum {
+    using Type = FieldSum<Field>;
+};
+
+template<>
+struct EntrySum<Rational> {
+    using Type = RationalAccumulator;
+};
+
+// A row of a named expression refers to it; a row of a temporary one holds the
+// expression moved into it, so auto row = (a + b)[0] stays valid.
+template<typename Expression, bool Owned = false>
+class ExpressionRow {
+private:
+    std::conditional_t<Owned, Expression, const Expression &> expression;
+    size_t offset;
+
+public:
+    template<typename Argument>
+    ExpressionRow(Argument &&expression_, size_t offset_)
+        : expression(std::forward<Argument>(expression_)), offset(offset_) {}
+
+    auto operator[](size_t j) const {
+        return expression.entry(offset + j);
+    }
+};
+
+// Base of the expression types. Expression provides Result (the matrix type it
+// evaluates to), Field, rows(), columns() and
+// - addTo(sum, i, multiplier, negative): adds +-multiplier * (entry i) to sum;
+// - assignRange(out, begin, count, multiplier): writes multiplier * (entries
+//   begin, ..., begin + count - 1) to out;
+// - addRange(out, begin, count, multiplier, negative): adds +-multiplier * (the
+//   same entries) to out;
+// - reads(values): whether a matrix of the expression stores its entries at
+//   values;
+// - readsAfterFirst(values): whether one besides the left-most does. Only
+//   the left-most matrix is read before assignRange writes to out.
+// A null multiplier stands for 1.
+template<typename Expression>
+class MatrixExpression {
+public:
+    const Expression &self() const {
+        return static_cast<const Expression &>(*this);
+    }
+
+    // Entry i of the row-major result.
+    auto entry(size_t i) const {
+        typename EntrySum<typename Expression::Field>::Type sum;
+        self().addTo(sum, i, nullptr, false);
+        return sum.value();
+    }
+
+    ExpressionRow<Expression> operator[](size_t i) const & {
+        return ExpressionRow<Expression>(self(), i * self().columns());
+    }
+
+    ExpressionRow<Expression, true> operator[](size_t i) && {
+        const size_t offset = i * self().columns();
+        return ExpressionRow<Expression, true>(static_cast<Expression &&>(*this), offset);
+    }
+
+    auto eval() const {
+        return typename Expression::Result(self());
+    }
+
+    // The matrix operations evaluate the expression first, so (A + B).det()
+    // reads as it did when A + B was a matrix.
+    auto det() const {
+        return eval().det();
+    }
+
+    size_t rank() const {
+        return eval().rank();
+    }
+
+    auto trace() const {
+        return eval().trace();
+    }
+
+    auto transposed() const {
+        return eval().transposed();
+    }
+
+    auto inverted() const {
+        return eval().inverted();
+    }
+
+    template<typename... Arguments>
+    auto gauss(Arguments... arguments) const {
+        return eval().gauss(arguments...);
+    }
+
+    std::vector<double> toDouble() const {
+        return eval().toDouble();
+    }
+};
+
+template<typename T>
+constexpr bool isMatrixExpression = std::is_base_of_v<MatrixExpression<T>, T>;
+
+// A matrix operand. A named matrix is referred to; an Owned term holds a
+// temporary matrix moved into it.
+template<typename Source, bool Owned = false>
+class MatrixTerm : public MatrixExpression<MatrixTerm<Source, Owned>> {
+public:
+    using Result = Source;
+    using Field = typename MatrixTraits<Source>::Field;
+
+private:
+    std::conditional_t<Owned, Source, const Source &> source;
+    const Field *values;
+
+public:
+    template<typename Argument, typename = std::enable_if_t<std::is_same_v<std::decay_t<Argument>, Source>>>
+    explicit MatrixTerm(Argument &&source_) : source(std::forward<Argument>(source_)), values(MatrixAccess::values(source)) {}
+
+    // values must point into the copy of an owned matrix.
+    MatrixTerm(const MatrixTerm &another) : source(another.source), values(MatrixAccess::values(source)) {}
+
+    MatrixTerm(MatrixTerm &&another) : source(std::move(another.source)), values(MatrixAccess::values(source)) {}
+
+    MatrixTerm &operator=(const MatrixTerm &) = delete;
+
+    const Source &matrix() const {
+        return source;
+    }
+
+    size_t rows() const {
+        return MatrixTraits<Source>::rows(source);
+    }
+
+    size_t columns() const {
+        return MatrixTraits<Source>::columns(source);
+    }
+
+    template<typename Sum>
+    void addTo(Sum &sum, size_t i, const Field *multiplier, bool negative) const {
+        if (multiplier) {
+            if (negative) {
+                sum.subtractProduct(values[i], *multiplier);
+            } else {
+                sum.addProduct(values[i], *multiplier);
+            }
+        } else if (negative) {
+            sum.subtract(values[i]);
+        } else {
+            sum.add(values[i]);
+        }
+    }
+
+    bool reads(const Field *another) const {
+        return values == another;
+    }
+
+    bool readsAfterFirst(const Field *) const {
+        return false;
+    }
+
+    void assignRange(Field *out, size_t begin, size_t count, const Field *multiplier) const {
+        if (multiplier) {
+            scaleArray(values + begin, *multiplier, out, count);
+        } else if (out != values + begin) {
+            std::copy(values + begin, values + begin + count, out);
+        }
+    }
+
+    void addRange(Field *out, size_t begin, size_t count, const Field *multiplier, bool negative) const {
+        if (!multiplier) {
+            if (negative) {
+                subtractArrays(out, values + begin, out, count);
+            } else {
+                addArrays(out, values + begin, out, count);
+            }
+        } else if (negative) {
+            subtractMultiple(out, values + begin, *multiplier, count);
+        } else {
+            subtractMultiple(out, values + begin, Field(0) - *multiplier, count);
+        }
+    }
+};
+
+template<typename Left, typename Right, bool Subtract>
+class SumExpression : public MatrixExpression<SumExpression<Left, Right, Subtract>> {
+public:
+    using Result = typename Left::Result;
+    using Field = typename Left::Field;
+
+    static_assert(std::is_same_v<Result, typename Right::Result>, "matrices of different types");
+
+private:
+    Left left;
+    Right right;
+
+public:
+    SumExpression(Left left_, Right right_) : left(std::move(left_)), right(std::move(right_)) {
+        assert(left.rows() == right.rows() && left.columns() == right.columns());
+    }
+
+    size_t rows() const {
+        return left.rows();
+    }
+
+    size_t columns() const {
+        return left.columns();
+    }
+
+    template<typename Sum>
+    void addTo(Sum &sum, size_t i, const Field *multiplier, bool negative) const {
+        left.addTo(sum, i, multiplier, negative);
+        right.addTo(sum, i, multiplier, negative != Subtract);
+    }
+
+    bool reads(const Field *values) const {
+        return left.reads(values) || right.reads(values);
+    }
+
+    bool readsAfterFirst(const Field *values) const {
+        return left.readsAfterFirst(values) || right.reads(values);
+    }
+
+    void assignRange(Field *out, size_t begin, size_t count, const Field *multiplier) const {
+        left.assignRange(out, begin, count, multiplier);
+        right.addRange(out, begin, count, multiplier, Subtract);
+    }
+
+    void addRange(Field *out, size_t begin, size_t count, const Field *multiplier, bool negative) const {
+        left.addRange(out, begin, count, multiplier, negative);
+        right.addRange(out, begin, count, multiplier, negative != Subtract);
+    }
+};
+
+template<typename Operand>
+class ScaledExpression : public MatrixExpression<ScaledExpression<Operand>> {
+public:
+    using Result = typename Operand::Result;
+    using Field = typename Operand::Field;
+
+private:
+    Operand operand;
+    Field multiplier;
+
+public:
+    ScaledExpression(Operand operand_, const Field &multiplier_) : operand(std::move(operand_)), multiplier(multiplier_) {}
+
+    const Operand &scaled() const & {
+        return operand;
+    }
+
+    Operand &&scaled() && {
+        return std::move(operand);
+    }
+
+    const Field &factor() const {
+        return multiplier;
+    }
+
+    size_t rows() const {
+        return operand.rows();
+    }
+
+    size_t columns() const {
+        return operand.columns();
+    }
+
+    template<typename Sum>
+    void addTo(Sum &sum, size_t i, const Field *outer, bool negative) const {
+        if (outer) {
+            const Field product = *outer * multiplier;
+            operand.addTo(sum, i, &product, negative);
+        } else {
+            operand.addTo(sum, i, &multiplier, negative);
+        }
+    }
+
+    bool reads(const Field *values) const {
+        return operand.reads(values);
+    }
+
+    bool readsAfterFirst(const Field *values) const {
+        return operand.readsAfterFirst(values);
+    }
+
+    void assignRange(Field *out, size_t begin, size_t count, const Field *outer) const {
+        if (outer) {
+            const Field product = *outer * multiplier;
+            operand.assignRange(out, begin, count, &product);
+        } else {
+            operand.assignRange(out, begin, count, &multiplier);
+        }
+    }
+
+    void addRange(Field *out, size_t begin, size_t count, const Field *outer, bool negative) const {
+        if (outer) {
+            const Field product = *outer * multiplier;
+            operand.addRange(out, begin, count, &product, negative);
+        } else {
+            operand.addRange(out, begin, count, &multiplier, negative);
+        }
+    }
+};
+
+template<typename T>
+struct IsScaledExpression : std::false_type {};
+
+template<typename Operand>
+struct IsScaledExpression<ScaledExpression<Operand>> : std::true_type {};
+
+template<typename T>
+struct IsMatrixTerm : std::false_type {};
+
+template<typename Source, bool Owned>
+struct IsMatrixTerm<MatrixTerm<Source, Owned>> : std::true_type {};
+
+// Matrices and expressions as operands of the elementwise operators: a matrix
+// enters an expression as a MatrixTerm, which owns it when it is an rvalue.
+// T is the decayed type; Operand is T, T & or const T & as forwarded.
+template<typename T, typename = void>
+struct OperandTraits {
+    static constexpr bool isOperand = false;
+};
+
+template<typename T>
+struct OperandTraits<T, std::enable_if_t<MatrixTraits<T>::isMatrix>> {
+    static constexpr bool isOperand = true;
+    template<typename Operand>
+    using Term = MatrixTerm<T, !std::is_lvalue_reference_v<Operand>>;
+    using Field = typename MatrixTraits<T>::Field;
+
+    template<typename Operand>
+    static Term<Operand> term(Operand &&matrix) {
+        return Term<Operand>(std::forward<Operand>(matrix));
+    }
+};
+
+template<typename T>
+struct OperandTraits<T, std::enable_if_t<isMatrixExpression<T>>> {
+    static constexpr bool isOperand = true;
+    template<typename Operand>
+    using Term = T;
+    using Field = typename T::Field;
+
+    template<typename Operand>
+    static T term(Operand &&expression) {
+        return std::forward<Operand>(expression);
+    }
+};
+
+template<typename T>
+constexpr bool isMatrixOperand = OperandTraits<std::decay_t<T>>::isOperand;
+
+template<typename Operand>
+using TermOf = typename OperandTraits<std::decay_t<Operand>>::template Term<Operand>;
+
+template<typename Operand>
+TermOf<Operand> termOf(Operand &&operand) {
+    return OperandTraits<std::decay_t<Operand>>::term(std::forward<Operand>(operand));
+}
+
+template<typename Operand>
+using FieldOf = typename OperandTraits<std::decay_t<Operand>>::Field;
+
+// Entries evaluated together by the array kernels.
+const size_t EXPRESSION_BLOCK = 1024;
+
+// Writes the entries of expression to values, row by row. values may be one
+// of the operands. A Rational entry is computed completely before it is
+// written. The block kernels write the left-most matrix of the expression to
+// the destination before they add the others, so when another one is the
+// destination every block is computed in a scratch block first.
+template<typename Expression>
+void evaluateExpression(const Expression &expression, typename Expression::Field *values) {
+    using Field = typename Expression::Field;
+    const size_t columns = expression.columns();
+    const bool buffered = !std::is_same_v<Field, Rational> && expression.readsAfterFirst(values);
+    parallelFor(0, expression.rows(), parallelGrain<Field>(columns), [&](size_t from, size_t to) {
+        if constexpr (std::is_same_v<Field, Rational>) {
+            for (size_t i = from * columns; i < to * columns; ++i) {
+                values[i] = expression.entry(i);
+            }
+        } else {
+            std::vector<Field> block(buffered ? EXPRESSION_BLOCK : 0, Field(0));
+            for (size_t i = from * columns; i < to * columns; i += EXPRESSION_BLOCK) {
+                const size_t count = std::min(EXPRESSION_BLOCK, to * columns - i);
+                if (buffered) {
+                    expression.assignRange(block.data(), i, count, nullptr);
+                    std::copy(block.begin(), block.begin() + count, values + i);
+                } else {
+                    expression.assignRange(values + i, i, count, nullptr);
+                }
+            }
+        }
+    });
+}
+
+template<typename Left, typename Right,
+         typename = std::enable_if_t<isMatrixOperand<Left> && isMatrixOperand<Right>>>
+auto operator+(Left &&left, Right &&right) {
+    using Sum = SumExpression<TermOf<Left>, TermOf<Right>, false>;
+    return Sum(termOf(std::forward<Left>(left)), termOf(std::forward<Right>(right)));
+}
+
+template<typename Left, typename Right,
+         typename = std::enable_if_t<isMatrixOperand<Left> && isMatrixOperand<Right>>>
+auto operator-(Left &&left, Right &&right) {
+    using Difference = SumExpression<TermOf<Left>, TermOf<Right>, true>;
+    return Difference(termOf(std::forward<Left>(left)), termOf(std::forward<Right>(right)));
+}
+
+// c * (d * A) is kept as (c * d) * A.
+template<typename Operand, typename = std::enable_if_t<isMatrixOperand<Operand>>>
+auto operator*(Operand &&operand, const FieldOf<Operand> &multiplier) {
+    using Term = TermOf<Operand>;
+    if constexpr (IsScaledExpression<Term>::value) {
+        const FieldOf<Operand> product = operand.factor() * multiplier;
+        return Term(std::forward<Operand>(operand).scaled(), product);
+    } else {
+        return ScaledExpression<Term>(termOf(std::forward<Operand>(operand)), multiplier);
+    }
+}
+
+template<typename Operand, typename = std::enable_if_t<isMatrixOperand<Operand>>>
+auto operator*(const FieldOf<Operand> &multiplier, Operand &&operand) {
+    return std::forward<Operand>(operand) * multiplier;
+}
+
+// An operand of a matrix product as multiplier * matrix. A scaled matrix is
+// used as it is and the multiplier goes into the multiply kernel, so
+// A * (c * B) is c * (A * B) without a scaled copy of B; any other expression
+// is evaluated first.
+template<typename Operand>
+class ProductFactor {
+private:
+    using Term = TermOf<const Operand &>;
+    using Result = typename Term::Result;
+    using Field = typename Term::Field;
+
+    std::optional<Result> evaluated;
+
+    template<typename Expression>
+    void take(const Expression &expression) {
+        if constexpr (IsMatrixTerm<Expression>::value) {
+            matrix = &expression.matrix();
+        } else {
+            evaluated.emplace(expression);
+            matrix = &*evaluated;
+        }
+    }
+
+public:
+    const Result *matrix = nullptr;
+    std::optional<Field> multiplier;
+
+    explicit ProductFactor(const Operand &operand) {
+        if constexpr (MatrixTraits<Operand>::isMatrix) {
+            matrix = &operand;
+        } else if constexpr (IsScaledExpression<Operand>::value) {
+            multiplier = operand.factor();
+            take(operand.scaled());
+        } else {
+            take(operand);
+        }
+    }
+
+    ProductFactor(const ProductFactor &) = delete;
+    ProductFactor &operator=(const ProductFactor &) = delete;
+};
+
+template<typename Left, typename Right,
+         typename = std::enable_if_t<isMatrixOperand<Left> && isMatrixOperand<Right> &&
+                                     (isMatrixExpression<Left> || isMatrixExpression<Right>)>>
+auto operator*(const Left &left, const Right &right) {
+    const ProductFactor<Left> first(left);
+    const ProductFactor<Right> second(right);
+    if (first.multiplier && second.multiplier) {
+        const auto multiplier = *first.multiplier * *second.multiplier;
+        return MatrixAccess::product(*first.matrix, *second.matrix, &multiplier);
+    }
+    const auto *multiplier = first.multiplier ? &*first.multiplier : second.multiplier ? &*second.multiplier : nullptr;
+    return MatrixAccess::product(*first.matrix, *second.matrix, multiplier);
+}
+
+template<typename Left, typename Right,
+         typename = std::enable_if_t<isMatrixOperand<Left> && isMatrixOperand<Right> &&
+                                     (isMatrixExpression<Left> || isMatrixExpression<Right>)>>
+bool operator==(const Left &left, const Right &right) {
+    using LeftResult = typename TermOf<const Left &>::Result;
+    using RightResult = typename TermOf<const Right &>::Result;
+    return LeftResult(left) == RightResult(right);
+}
+
+template<typename Left, typename Right,
+         typename = std::enable_if_t<isMatrixOperand<Left> && isMatrixOperand<Right> &&
+                                     (isMatrixExpression<Left> || isMatrixExpression<Right>)>>
+bool operator!=(const Left &left, const Right &right) {
+    return !(left == right);
+}
+
+template<typename Expression, typename = std::enable_if_t<isMatrixExpression<Expression>>>
+std::ostream &operator<<(std::ostream &out, const Expression &expression) {
+    return out << expression.eval();
+}
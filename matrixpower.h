@@ -0,0 +1,345 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+#include "biginteger.h"
+#include "rational.h"
+#include "residue.h"
+#include "kernels.h"
+#include "matrixalgorithms.h"
+
+// Powers of square matrices and terms of linear recurrences, on row-major
+// arrays as in matrixalgorithms.h.
+//
+// PowerMethod::Binary squares and multiplies, about 1.5 products per bit of
+// the exponent. PowerMethod::CharacteristicPolynomial reduces x^exponent
+// modulo the characteristic polynomial of A (Cayley-Hamilton), which costs
+// polynomial products of degree N per bit, and evaluates the remainder at A
+// with about 2 sqrt(N) matrix products. Automatic takes the second one when it
+// needs fewer products, except over Rational, whose entries would grow in the
+// characteristic polynomial instead.
+
+enum class PowerMethod {
+    Automatic,
+    Binary,
+    CharacteristicPolynomial
+};
+
+// An exponent given as a long long or a BigInteger, read bit by bit from its
+// absolute value. A BigInteger exponent is copied, so the PowerExponent does
+// not depend on the lifetime of its argument.
+class PowerExponent {
+private:
+    BigInteger big;
+    bool isBig = false;
+    unsigned long long word = 0;
+    bool negative_ = false;
+
+public:
+    PowerExponent(long long exponent)
+        : word(exponent < 0 ? 0ULL - (unsigned long long)(exponent) : (unsigned long long)(exponent)),
+          negative_(exponent < 0) {}
+
+    PowerExponent(const BigInteger &exponent) : big(exponent), isBig(true), negative_(exponent < BigInteger(0)) {}
+
+    bool negative() const {
+        return negative_;
+    }
+
+    size_t bitLength() const {
+        return isBig ? big.bitLength() : size_t(64 - (word == 0 ? 64 : __builtin_clzll(word)));
+    }
+
+    bool bit(size_t index) const {
+        return isBig ? big.bit(index) : index < 64 && (word >> index) & 1;
+    }
+
+    size_t bitCount() const {
+        size_t count = 0;
+        for (size_t i = 0; i < bitLength(); ++i) {
+            count += bit(i);
+        }
+        return count;
+    }
+};
+
+template<typename Field>
+void setIdentity(Field *data, size_t n) {
+    std::fill(data, data + n * n, Field(0));
+    for (size_t i = 0; i < n; ++i) {
+        data[i * n + i] = Field(1);
+    }
+}
+
+// Left-to-right binary powering: the result is squared, and multiplied by the
+// base for every set bit. Each product is written to the other of two buffers
+// and the buffers swap roles, so there is no result matrix per step; the
+// product kernel still allocates its packed panels and, above the Strassen
+// threshold, its temporaries. result must not overlap base.
+template<typename Field>
+void binaryPower(const Field *base, size_t n, const PowerExponent &exponent, Field *result) {
+    const size_t bits = exponent.bitLength();
+    if (bits == 0) {
+        setIdentity(result, n);
+        return;
+    }
+    std::vector<Field> buffer(n * n, Field(0));
+    Field *current = result;
+    Field *next = buffer.data();
+    std::copy(base, base + n * n, current);
+    for (size_t i = bits - 1; i-- > 0;) {
+        multiplyKernel(current, n, current, n, next, n, n, n, n);
+        std::swap(current, next);
+        if (exponent.bit(i)) {
+            multiplyKernel(current, n, base, n, next, n, n, n, n);
+            std::swap(current, next);
+        }
+    }
+    if (current != result) {
+        std::copy(current, current + n * n, result);
+    }
+}
+
+// Coefficients c_0, ..., c_(n - 1) of the characteristic polynomial
+// x^n + c_(n - 1) x^(n - 1) + ... + c_0 of the n x n matrix in data. The
+// matrix is brought to upper Hessenberg form by similarity transformations and
+// the polynomial is expanded along the subdiagonal, O(n^3) operations in all.
+// The eliminations of one column commute, so all rows below the pivot row are
+// updated first and column j + 1 then takes a dot product per row instead of
+// one strided pass per eliminated row.
+template<typename Field>
+std::vector<Field> characteristicPolynomial(const Field *data, size_t n) {
+    LimbPoolScope limbPool;
+    const Field zero(0);
+    std::vector<Field> h(data, data + n * n);
+    std::vector<Field> multipliers(n, zero);
+    for (size_t j = 0; j + 2 < n; ++j) {
+        size_t pivot = j + 1;
+        while (pivot < n && h[pivot * n + j] == zero) {
+            ++pivot;
+        }
+        if (pivot == n) {
+            continue;
+        }
+        if (pivot != j + 1) {
+            std::swap_ranges(h.begin() + pivot * n, h.begin() + (pivot + 1) * n, h.begin() + (j + 1) * n);
+            for (size_t i = 0; i < n; ++i) {
+                std::swap(h[i * n + pivot], h[i * n + j + 1]);
+            }
+        }
+        const Field pivotInverse = inverse(h[(j + 1) * n + j]);
+        const Field *pivotRow = h.data() + (j + 1) * n;
+        parallelFor(j + 2, n, parallelGrain<Field>(n - j), [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i) {
+                Field *row = h.data() + i * n;
+                multipliers[i] = row[j] * pivotInverse;
+                if (multipliers[i] != zero) {
+                    subtractMultiple(row + j, pivotRow + j, multipliers[i], n - j);
+                }
+            }
+        });
+        parallelFor(0, n, parallelGrain<Field>(n - j), [&](size_t from, size_t to) {
+            for (size_t t = from; t < to; ++t) {
+                Field *row = h.data() + t * n;
+                row[j + 1] += dotProduct(row + j + 2, multipliers.data() + j + 2, n - j - 2);
+            }
+        });
+    }
+    // polynomials[k] is the characteristic polynomial of the leading k x k
+    // block, k + 1 coefficients, lowest first.
+    std::vector<std::vector<Field>> polynomials(n + 1);
+    polynomials[0] = {Field(1)};
+    for (size_t k = 0; k < n; ++k) {
+        std::vector<Field> &next = polynomials[k + 1];
+        const std::vector<Field> &last = polynomials[k];
+        next.assign(k + 2, zero);
+        std::copy(last.begin(), last.end(), next.begin() + 1);
+        subtractMultiple(next.data(), last.data(), h[k * n + k], k + 1);
+        Field product(1);
+        for (size_t i = k; i-- > 0;) {
+            product *= h[(i + 1) * n + i];
+            if (product == zero) {
+                break;
+            }
+            subtractMultiple(next.data(), polynomials[i].data(), product * h[i * n + k], i + 1);
+        }
+    }
+    polynomials[n].pop_back();
+    return polynomials[n];
+}
+
+// x^exponent modulo the monic polynomial x^d + modulus[d - 1] x^(d - 1) + ...
+// + modulus[0], d coefficients, lowest first; the sign of exponent is
+// ignored. Every step is a square of the remainder (dot products with its
+// reversed copy) and possibly a shift, each followed by the reduction of the
+// terms from x^d on.
+template<typename Field>
+std::vector<Field> powerOfX(const std::vector<Field> &modulus, const PowerExponent &exponent) {
+    const size_t d = modulus.size();
+    const Field zero(0);
+    std::vector<Field> remainder(d, zero);
+    if (d == 0) {
+        return remainder;
+    }
+    std::vector<Field> reversed(d, zero);
+    std::vector<Field> square(2 * d - 1, zero);
+    remainder[0] = Field(1);
+    for (size_t i = exponent.bitLength(); i-- > 0;) {
+        if (i + 1 < exponent.bitLength()) {
+            std::reverse_copy(remainder.begin(), remainder.end(), reversed.begin());
+            for (size_t k = 0; k < 2 * d - 1; ++k) {
+                const size_t from = k < d ? 0 : k - d + 1;
+                const size_t to = std::min(k, d - 1);
+                square[k] = dotProduct(remainder.data() + from, reversed.data() + (d - 1 + from - k), to - from + 1);
+            }
+            for (size_t k = 2 * d - 2; k >= d; --k) {
+                if (square[k] != zero) {
+                    subtractMultiple(square.data() + k - d, modulus.data(), square[k], d);
+                }
+            }
+            std::copy(square.begin(), square.begin() + d, remainder.begin());
+        }
+        if (exponent.bit(i)) {
+            const Field top = remainder[d - 1];
+            std::copy_backward(remainder.begin(), remainder.end() - 1, remainder.end());
+            remainder[0] = zero;
+            if (top != zero) {
+                subtractMultiple(remainder.data(), modulus.data(), top, d);
+            }
+        }
+    }
+    return remainder;
+}
+
+// coefficients[0] I + coefficients[1] A + ... + coefficients[count - 1]
+// A^(count - 1) by Paterson-Stockmeyer: with s = ceil(sqrt(count)) and
+// A^0, ..., A^s computed once, the polynomial is a polynomial in A^s whose
+// coefficients are combinations of the stored powers, evaluated by Horner's
+// rule, about 2 sqrt(count) products in all.
+template<typename Field>
+void evaluateAtMatrix(const Field *a, size_t n, const Field *coefficients, size_t count, Field *result) {
+    const Field zero(0);
+    const size_t area = n * n;
+    std::fill(result, result + area, zero);
+    while (count > 0 && coefficients[count - 1] == zero) {
+        --count;
+    }
+    if (count == 0) {
+        return;
+    }
+    size_t step = 1;
+    while (step * step < count) {
+        ++step;
+    }
+    const size_t blocks = (count + step - 1) / step;
+    const size_t stored = blocks > 1 ? step : std::min(step, count - 1);
+    std::vector<Field> powers(stored * area, zero);
+    if (stored > 0) {
+        std::copy(a, a + area, powers.begin());
+    }
+    for (size_t i = 1; i < stored; ++i) {
+        multiplyKernel(powers.data() + (i - 1) * area, n, a, n, powers.data() + i * area, n, n, n, n);
+    }
+    // power(i) is A^i for 1 <= i <= stored.
+    auto power = [&](size_t i) {
+        return powers.data() + (i - 1) * area;
+    };
+    std::vector<Field> buffer(area, zero);
+    Field *current = result;
+    Field *next = buffer.data();
+    for (size_t block = blocks; block-- > 0;) {
+        if (block + 1 < blocks) {
+            multiplyKernel(current, n, power(step), n, next, n, n, n, n);
+            std::swap(current, next);
+        }
+        for (size_t i = 0; i < step && block * step + i < count; ++i) {
+            const Field &coefficient = coefficients[block * step + i];
+            if (coefficient == zero) {
+                continue;
+            }
+            if (i == 0) {
+                for (size_t t = 0; t < n; ++t) {
+                    current[t * n + t] += coefficient;
+                }
+            } else {
+                subtractMultiple(current, power(i), zero - coefficient, area);
+            }
+        }
+    }
+    if (current != result) {
+        std::copy(current, current + area, result);
+    }
+}
+
+// Whether every nonzero Field element has an inverse, which inverting A and
+// the characteristic polynomial need; residues modulo a composite have zero
+// divisors and are raised by Binary only.
+template<typename Field>
+struct HasInverses : std::true_type {};
+
+template<size_t N>
+struct HasInverses<Residue<N>> : std::bool_constant<IsPrime<N>::value> {};
+
+template<typename Field>
+bool preferCharacteristicPolynomial(size_t n, const PowerExponent &exponent) {
+    if (std::is_same_v<Field, Rational> || !HasInverses<Field>::value || n < 2) {
+        return false;
+    }
+    const size_t binaryProducts = exponent.bitLength() + exponent.bitCount();
+    const size_t evaluationProducts = 2 * size_t(std::ceil(std::sqrt(double(n)))) + 2;
+    return binaryProducts > evaluationProducts;
+}
+
+// result = A^exponent for the n x n matrix A in data; result must not overlap
+// data. A negative exponent raises the inverse of A, which must exist. Without
+// HasInverses the exponent must be nonnegative and the method Binary or
+// Automatic.
+template<typename Field>
+void matrixPower(const Field *data, size_t n, const PowerExponent &exponent, Field *result,
+                 PowerMethod method = PowerMethod::Automatic) {
+    LimbPoolScope limbPool;
+    std::vector<Field> inverse;
+    if (method == PowerMethod::Automatic) {
+        method = preferCharacteristicPolynomial<Field>(n, exponent) ? PowerMethod::CharacteristicPolynomial
+                                                                     : PowerMethod::Binary;
+    }
+    if constexpr (HasInverses<Field>::value) {
+        if (exponent.negative()) {
+            inverse.assign(data, data + n * n);
+            [[maybe_unused]] const bool invertible = invertMatrix(inverse.data(), n);
+            assert(invertible && "negative power of a singular matrix");
+            data = inverse.data();
+        }
+        if (method == PowerMethod::CharacteristicPolynomial) {
+            const std::vector<Field> remainder = powerOfX(characteristicPolynomial(data, n), exponent);
+            evaluateAtMatrix(data, n, remainder.data(), remainder.size(), result);
+            return;
+        }
+    } else {
+        assert(!exponent.negative() && "negative power over a ring without inverses");
+        assert(method == PowerMethod::Binary && "characteristic polynomial over a ring without inverses");
+    }
+    binaryPower(data, n, exponent, result);
+}
+
+// Term index of the sequence a_k = coefficients[0] a_(k - 1) + ... +
+// coefficients[d - 1] a_(k - d) that starts with initial = a_0, ..., a_(d - 1)
+// (Kitamasa): a_index is the combination of the initial terms with the
+// coefficients of x^index modulo x^d - coefficients[0] x^(d - 1) - ... -
+// coefficients[d - 1], O(d^2) operations per bit of index.
+template<typename Field>
+Field recurrenceTerm(const std::vector<Field> &coefficients, const std::vector<Field> &initial,
+                     const PowerExponent &index) {
+    assert(!index.negative() && initial.size() == coefficients.size());
+    LimbPoolScope limbPool;
+    const size_t d = coefficients.size();
+    std::vector<Field> modulus(d, Field(0));
+    for (size_t i = 0; i < d; ++i) {
+        modulus[i] = Field(0) - coefficients[d - 1 - i];
+    }
+    const std::vector<Field> remainder = powerOfX(modulus, index);
+    return dotProduct(remainder.data(), initial.data(), d);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+#include <type_traits>
+
+template<typename Field>
+class RowView {
+private:
+    using Value = std::remove_const_t<Field>;
+
+    Field *data = nullptr;
+    size_t length = 0;
+
+public:
+    RowView(Field *data_, size_t length_) : data(data_), length(length_) {}
+
+    RowView(const RowView &another) = default;
+
+    RowView &operator=(const RowView &another) {
+        for (size_t i = 0; i < length; ++i) {
+            data[i] = another[i];
+        }
+        return *this;
+    }
+
+    template<typename AnotherField>
+    RowView &operator=(const RowView<AnotherField> &another) {
+        for (size_t i = 0; i < length; ++i) {
+            data[i] = another[i];
+        }
+        return *this;
+    }
+
+    RowView &operator=(const std::vector<Value> &values) {
+        for (size_t i = 0; i < length; ++i) {
+            data[i] = values[i];
+        }
+        return *this;
+    }
+
+    Field &operator[](size_t i) const {
+        return data[i];
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    Field *begin() const {
+        return data;
+    }
+
+    Field *end() const {
+        return data + length;
+    }
+
+    operator RowView<const Field>() const {
+        return RowView<const Field>(data, length);
+    }
+
+    operator std::vector<Value>() const {
+        return std::vector<Value>(data, data + length);
+    }
+
+    template<typename AnotherField>
+    bool operator==(const RowView<AnotherField> &another) const {
+        if (length != another.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (data[i] != another[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename AnotherField>
+    bool operator!=(const RowView<AnotherField> &another) const {
+        return !(*this == another);
+    }
+};
+
+template<typename Field>
+class ColumnView {
+private:
+    using Value = std::remove_const_t<Field>;
+
+    Field *data = nullptr;
+    size_t length = 0;
+    size_t stride = 0;
+
+public:
+    ColumnView(Field *data_, size_t length_, size_t stride_) : data(data_), length(length_), stride(stride_) {}
+
+    ColumnView(const ColumnView &another) = default;
+
+    ColumnView &operator=(const ColumnView &another) {
+        for (size_t i = 0; i < length; ++i) {
+            (*this)[i] = another[i];
+        }
+        return *this;
+    }
+
+    ColumnView &operator=(const std::vector<Value> &values) {
+        for (size_t i = 0; i < length; ++i) {
+            (*this)[i] = values[i];
+        }
+        return *this;
+    }
+
+    Field &operator[](size_t i) const {
+        return data[i * stride];
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    operator ColumnView<const Field>() const {
+        return ColumnView<const Field>(data, length, stride);
+    }
+
+    operator std::vector<Value>() const {
+        std::vector<Value> result;
+        result.reserve(length);
+        for (size_t i = 0; i < length; ++i) {
+            result.push_back((*this)[i]);
+        }
+        return result;
+    }
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "biginteger.h"
+#include "rational.h"
+#include "residue.h"
+#include "kernels.h"
+#include "bareiss.h"
+#include "threadpool.h"
+
+// Multi-modular determinant and rank of integer matrices: the matrix is
+// reduced modulo word-sized primes, eliminated modulo every prime and the
+// exact result is reconstructed by the Chinese remainder theorem.
+// The number of primes comes from Hadamard's bound |det| <= prod ||row||.
+
+constexpr uint32_t MULTI_MODULAR_PRIMES[] = {
+    2147483647, 2147483629, 2147483587, 2147483579, 2147483563, 2147483549,
+    2147483543, 2147483497, 2147483489, 2147483477, 2147483423, 2147483399,
+    2147483353, 2147483323, 2147483269, 2147483249, 2147483237, 2147483179,
+    2147483171, 2147483137, 2147483123, 2147483077, 2147483069, 2147483059,
+    2147483053, 2147483033, 2147483029, 2147482951, 2147482949, 2147482943,
+    2147482937, 2147482921, 2147482877, 2147482873, 2147482867, 2147482859,
+    2147482819, 2147482817, 2147482811, 2147482801, 2147482763, 2147482739,
+    2147482697, 2147482693, 2147482681, 2147482663, 2147482661, 2147482621,
+    2147482591, 2147482583, 2147482577, 2147482507, 2147482501, 2147482481,
+    2147482417, 2147482409, 2147482367, 2147482361, 2147482349, 2147482343,
+    2147482327, 2147482291, 2147482273, 2147482237, 2147482231, 2147482223,
+    2147482121, 2147482093, 2147482091, 2147482081, 2147482063, 2147482021,
+    2147481997, 2147481967, 2147481949, 2147481937, 2147481907, 2147481901,
+    2147481899, 2147481893, 2147481883, 2147481863, 2147481827, 2147481811,
+    2147481797, 2147481793, 2147481673, 2147481629, 2147481571, 2147481563,
+    2147481529, 2147481509, 2147481499, 2147481491, 2147481487, 2147481373,
+    2147481367, 2147481359, 2147481353, 2147481337, 2147481317, 2147481311,
+    2147481283, 2147481269, 2147481263, 2147481247, 2147481209, 2147481199,
+    2147481179, 2147481173, 2147481151, 2147481143, 2147481139, 2147481071,
+    2147481053, 2147481031, 2147481019, 2147480989, 2147480971, 2147480969,
+    2147480957, 2147480941, 2147480927, 2147480921, 2147480899, 2147480897,
+    2147480893, 2147480849,
+};
+
+constexpr size_t MULTI_MODULAR_PRIME_COUNT = sizeof(MULTI_MODULAR_PRIMES) / sizeof(MULTI_MODULAR_PRIMES[0]);
+
+// Matrices of at least this size use the multi-modular det() and rank() over Rational.
+const size_t MULTI_MODULAR_THRESHOLD = 8;
+
+// Rows of words modulo a runtime prime are updated by the vector kernels of
+// the Residue rows and get the same grain.
+template<>
+struct ParallelGrain<uint32_t> {
+    static constexpr size_t operations = 16384;
+};
+
+// Elimination modulo one prime of the table. The primes are runtime values
+// here: one Residue<P> instantiation per prime would multiply the compile time
+// by the size of the table. The reduction and the vector row updates are the
+// ones Residue uses (barrettReduce, simd.h). Returns the rank; det receives the
+// determinant of a square matrix.
+size_t eliminateModulo(const BigInteger *integers, size_t rows, size_t columns, uint32_t prime, uint32_t &det) {
+    const uint64_t factor = ~uint64_t(0) / prime;
+    std::vector<uint32_t> data(rows * columns);
+    for (size_t i = 0; i < rows * columns; ++i) {
+        data[i] = uint32_t(integers[i].residue(int(prime)));
+    }
+    uint64_t determinant = 1;
+    size_t k = 0;
+    for (size_t i = 0; i < columns && k < rows; ++i) {
+        size_t j = k;
+        while (j < rows && data[j * columns + i] == 0) {
+            ++j;
+        }
+        if (j == rows) {
+            continue;
+        }
+        if (j != k) {
+            std::swap_ranges(data.begin() + j * columns, data.begin() + (j + 1) * columns, data.begin() + k * columns);
+            determinant = prime - determinant;
+        }
+        const uint32_t *pivotRow = data.data() + k * columns;
+        determinant = barrettReduce(determinant * pivotRow[i], prime, factor);
+        const uint64_t pivotInverse = uint64_t(binPow(int(pivotRow[i]), prime - 2, prime));
+        const size_t width = columns - i;
+        parallelFor(k + 1, rows, parallelGrain<uint32_t>(width), [&](size_t from, size_t to) {
+            for (size_t t = from; t < to; ++t) {
+                uint32_t *row = data.data() + t * columns;
+                if (row[i] == 0) {
+                    continue;
+                }
+                const uint32_t coefficient = uint32_t(barrettReduce(row[i] * pivotInverse, prime, factor));
+                if (!subtractMultipleModularSimd(row + i, pivotRow + i, coefficient, width, prime)) {
+                    const uint64_t negated = prime - coefficient;
+                    for (size_t s = 0; s < width; ++s) {
+                        row[i + s] = uint32_t(barrettReduce(row[i + s] + negated * pivotRow[i + s], prime, factor));
+                    }
+                }
+            }
+        });
+        ++k;
+    }
+    det = k == rows && k == columns ? uint32_t(determinant) : 0;
+    return k;
+}
+
+// Squared Euclidean norms of the rows; with atLeastOne every norm is raised to
+// 1, which bounds every minor instead of the whole determinant.
+BigInteger squaredHadamardBound(const BigInteger *integers, size_t rows, size_t columns, bool atLeastOne) {
+    BigInteger bound = 1;
+    for (size_t i = 0; i < rows; ++i) {
+        BigInteger norm = 0;
+        for (size_t j = 0; j < columns; ++j) {
+            norm += integers[i * columns + j] * integers[i * columns + j];
+        }
+        if (!atLeastOne || norm != 0) {
+            bound *= norm;
+        }
+    }
+    return bound;
+}
+
+// Number of primes whose product P satisfies P^2 > squaredLimit, or
+// MULTI_MODULAR_PRIME_COUNT + 1 if the table is too short.
+size_t primesForBound(const BigInteger &squaredLimit) {
+    BigInteger product = 1;
+    for (size_t count = 0; count < MULTI_MODULAR_PRIME_COUNT; ++count) {
+        product *= BigInteger(int(MULTI_MODULAR_PRIMES[count]));
+        if (product * product > squaredLimit) {
+            return count + 1;
+        }
+    }
+    return MULTI_MODULAR_PRIME_COUNT + 1;
+}
+
+// Incremental Garner step: value (mod modulus) becomes the residue of
+// value + modulus * t that is congruent to remainder modulo prime.
+void crtCombine(BigInteger &value, BigInteger &modulus, uint32_t remainder, uint32_t prime) {
+    const int p = int(prime);
+    int64_t difference = int64_t(remainder) - value.residue(p);
+    if (difference < 0) {
+        difference += p;
+    }
+    int64_t inverse = binPow(modulus.residue(p), prime - 2, prime);
+    int t = int(difference * inverse % p);
+    value += modulus * BigInteger(t);
+    modulus *= BigInteger(p);
+}
+
+BigInteger symmetricRemainder(const BigInteger &value, const BigInteger &modulus) {
+    return value + value > modulus ? value - modulus : value;
+}
+
+// Determinant of the n x n integer matrix. With earlyTermination the primes
+// are processed one round at a time and the computation stops once the
+// reconstruction has not changed for two more primes (a wrong result then has
+// probability below 2^-60); otherwise Hadamard's bound decides. Returns false
+// when the bound needs more primes than the table has.
+bool multiModularDet(const BigInteger *integers, size_t n, BigInteger &det, bool earlyTermination = false) {
+    const size_t needed = primesForBound(squaredHadamardBound(integers, n, n, false) * 4);
+    if (needed > MULTI_MODULAR_PRIME_COUNT) {
+        return false;
+    }
+    const size_t round = earlyTermination ? matrixThreads() : needed;
+    std::vector<uint32_t> remainders(needed);
+    BigInteger value = 0;
+    BigInteger modulus = 1;
+    BigInteger previous = 0;
+    size_t stable = 0;
+    for (size_t done = 0; done < needed;) {
+        const size_t end = std::min(done + round, needed);
+        parallelFor(done, end, 1, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i) {
+                eliminateModulo(integers, n, n, MULTI_MODULAR_PRIMES[i], remainders[i]);
+            }
+        });
+        for (; done < end; ++done) {
+            crtCombine(value, modulus, remainders[done], MULTI_MODULAR_PRIMES[done]);
+            BigInteger current = symmetricRemainder(value, modulus);
+            stable = current == previous ? stable + 1 : 0;
+            previous = current;
+        }
+        if (earlyTermination && stable >= 2) {
+            break;
+        }
+    }
+    det = previous;
+    return true;
+}
+
+// Rank of the rows x columns integer matrix: the rank modulo a prime never
+// exceeds the rational rank and is smaller only if the prime divides every
+// maximal non-zero minor, so primes are tried until their product exceeds the
+// bound on the minors or the rank is full. Returns false when the table is
+// too short.
+bool multiModularRank(const BigInteger *integers, size_t rows, size_t columns, size_t &rank) {
+    const size_t needed = primesForBound(squaredHadamardBound(integers, rows, columns, true));
+    if (needed > MULTI_MODULAR_PRIME_COUNT) {
+        return false;
+    }
+    rank = 0;
+    uint32_t det = 0;
+    for (size_t i = 0; i < needed && rank < std::min(rows, columns); ++i) {
+        rank = std::max(rank, eliminateModulo(integers, rows, columns, MULTI_MODULAR_PRIMES[i], det));
+    }
+    return true;
+}
+
+Rational multiModularDet(const Rational *values, size_t n, bool earlyTermination = false) {
+    std::vector<BigInteger> integers(n * n);
+    BigInteger scales = 1;
+    for (size_t i = 0; i < n; ++i) {
+        scales *= clearDenominators(values + i * n, n, integers.data() + i * n);
+    }
+    BigInteger det;
+    if (!multiModularDet(integers.data(), n, det, earlyTermination)) {
+        return bareissDet(values, n);
+    }
+    return Rational(det, scales);
+}
+
+size_t multiModularRank(const Rational *values, size_t rows, size_t columns) {
+    std::vector<BigInteger> integers(rows * columns);
+    for (size_t i = 0; i < rows; ++i) {
+        clearDenominators(values + i * columns, columns, integers.data() + i * columns);
+    }
+    size_t rank = 0;
+    if (!multiModularRank(integers.data(), rows, columns, rank)) {
+        return bareissRank(values, rows, columns);
+    }
+    return rank;
+}
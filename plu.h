@@ -0,0 +1,195 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include "matrix.h"
+
+// Factorization P * A = L * U of a square matrix, computed once and reused for
+// any number of det(), rank(), solve() and inverse() calls. L (unit lower
+// triangular, diagonal not stored) and U (row echelon form) share one N x N
+// buffer; row i of P * A is row permutation()[i] of A. The elimination is the
+// one of gauss(): a column without a pivot is skipped, so rank() is exact for
+// singular matrices as well.
+//
+// Over Rational the entries of a solution grow with every substitution step,
+// so a non-singular factorization also keeps a copy of the matrix, and the
+// first block solve() or inverse() computes the inverse from it fraction-free
+// as in inverted(): a block of right-hand sides is then one product, which the
+// kernel computes on integers. Factorizations used only for det(), rank() or
+// the factors never pay for the inverse.
+template<size_t N, typename Field = Rational>
+class PLU {
+private:
+    std::vector<Field> lu;
+    std::vector<size_t> rows;
+    std::vector<Field> pivotInverses;
+    size_t pivots = 0;
+    int sign = 1;
+
+    // Shared by the copies of the factorization; call_once makes the first
+    // use from several threads compute it once.
+    struct RationalInverse {
+        std::once_flag computed;
+        std::vector<Field> matrix;
+        std::vector<Field> values;
+    };
+    std::shared_ptr<RationalInverse> rationalInverse;
+
+    const std::vector<Field> &inverseValues() const {
+        RationalInverse &inverse = *rationalInverse;
+        std::call_once(inverse.computed, [&inverse] {
+            LimbPoolScope limbPool;
+            inverse.values.resize(N * N);
+            bareissInverse(inverse.matrix.data(), N, inverse.values.data());
+            inverse.matrix = std::vector<Field>();
+        });
+        return inverse.values;
+    }
+
+    // Solves A * x = b in place for b given in the order of P * A: forward
+    // substitution with L, then back substitution with U.
+    void substitute(Field *x) const {
+        for (size_t i = 1; i < N; ++i) {
+            x[i] -= dotProduct(lu.data() + i * N, x, i);
+        }
+        for (size_t i = N - 1; i + 1 != 0; --i) {
+            const Field *row = lu.data() + i * N;
+            x[i] = (x[i] - dotProduct(row + i + 1, x + i + 1, N - i - 1)) * pivotInverses[i];
+        }
+    }
+
+public:
+    explicit PLU(const Matrix<N, N, Field> &matrix) : lu(matrix.matrix), rows(N) {
+        LimbPoolScope limbPool;
+        const Field zero(0);
+        for (size_t i = 0; i < N; ++i) {
+            rows[i] = i;
+        }
+        Field *data = lu.data();
+        for (size_t i = 0; i < N && pivots < N; ++i) {
+            const size_t k = pivots;
+            size_t j = k;
+            while (j < N && data[j * N + i] == zero) {
+                ++j;
+            }
+            if (j == N) {
+                continue;
+            }
+            if (j != k) {
+                std::swap_ranges(data + j * N, data + (j + 1) * N, data + k * N);
+                std::swap(rows[j], rows[k]);
+                sign = -sign;
+            }
+            const Field *pivotRow = data + k * N;
+            const Field pivotInverse = ::inverse(pivotRow[i]);
+            const size_t width = N - i - 1;
+            parallelFor(k + 1, N, parallelGrain<Field>(width), [&](size_t from, size_t to) {
+                for (size_t t = from; t < to; ++t) {
+                    Field *row = data + t * N;
+                    if (row[i] == zero) {
+                        continue;
+                    }
+                    Field multiplier = row[i] * pivotInverse;
+                    subtractMultiple(row + i + 1, pivotRow + i + 1, multiplier, width);
+                    row[i] = zero;
+                    row[k] = multiplier;
+                }
+            });
+            ++pivots;
+        }
+        if (pivots == N) {
+            for (size_t i = 0; i < N; ++i) {
+                pivotInverses.push_back(data[i * N + i]);
+            }
+            invertAll(pivotInverses.data(), N);
+            if constexpr (std::is_same_v<Field, Rational>) {
+                rationalInverse = std::make_shared<RationalInverse>();
+                rationalInverse->matrix = matrix.matrix;
+            }
+        }
+    }
+
+    size_t rank() const {
+        return pivots;
+    }
+
+    Field det() const {
+        if (pivots < N) {
+            return Field(0);
+        }
+        Field det = Field(sign);
+        for (size_t i = 0; i < N; ++i) {
+            det *= lu[i * N + i];
+        }
+        return det;
+    }
+
+    const std::vector<size_t> &permutation() const {
+        return rows;
+    }
+
+    Matrix<N, N, Field> lower() const {
+        Matrix<N, N, Field> result;
+        for (size_t i = 0; i < N; ++i) {
+            std::copy(lu.begin() + i * N, lu.begin() + i * N + i, result.matrix.begin() + i * N);
+        }
+        return result;
+    }
+
+    Matrix<N, N, Field> upper() const {
+        Matrix<N, N, Field> result;
+        for (size_t i = 0; i < N; ++i) {
+            std::fill(result.matrix.begin() + i * N, result.matrix.begin() + i * N + i, Field(0));
+            std::copy(lu.begin() + i * N + i, lu.begin() + (i + 1) * N, result.matrix.begin() + i * N + i);
+        }
+        return result;
+    }
+
+    // solve() and inverse() need a non-singular matrix (rank() == N).
+    std::vector<Field> solve(const std::vector<Field> &b) const {
+        LimbPoolScope limbPool;
+        std::vector<Field> x(N, Field(0));
+        for (size_t i = 0; i < N; ++i) {
+            x[i] = b[rows[i]];
+        }
+        substitute(x.data());
+        return x;
+    }
+
+    // Every column of b is an independent right-hand side; the columns are
+    // split between the threads.
+    template<size_t K>
+    Matrix<N, K, Field> solve(const Matrix<N, K, Field> &b) const {
+        LimbPoolScope limbPool;
+        Matrix<N, K, Field> result;
+        if constexpr (std::is_same_v<Field, Rational>) {
+            multiplyKernel(inverseValues().data(), N, b.matrix.data(), K, result.matrix.data(), K, N, N, K);
+            return result;
+        }
+        parallelFor(0, K, parallelGrain<Field>(N * N), [&](size_t from, size_t to) {
+            std::vector<Field> x(N, Field(0));
+            for (size_t c = from; c < to; ++c) {
+                for (size_t i = 0; i < N; ++i) {
+                    x[i] = b.matrix[rows[i] * K + c];
+                }
+                substitute(x.data());
+                for (size_t i = 0; i < N; ++i) {
+                    result.matrix[i * K + c] = x[i];
+                }
+            }
+        });
+        return result;
+    }
+
+    Matrix<N, N, Field> inverse() const {
+        if constexpr (std::is_same_v<Field, Rational>) {
+            Matrix<N, N, Field> result;
+            result.matrix = inverseValues();
+            return result;
+        }
+        return solve(Matrix<N, N, Field>());
+    }
+};
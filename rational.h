@@ -1,7 +1,16 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <string>
 #include "biginteger.h"
+#include "gcd.h"
 
 class Rational;
+class RationalAccumulator;
 Rational operator+(const Rational &first, const Rational &second);
 Rational operator-(const Rational &first, const Rational &second);
 Rational operator*(const Rational &first, const Rational &second);
@@ -14,79 +23,312 @@ bool operator>=(const Rational &first, const Rational &second);
 
 class Rational {
 private:
+    // Values whose numerator and denominator fit into a word (strictly between
+    // -2^63 and 2^63) are kept in smallNumerator / smallDenominator and
+    // computed with 128-bit intermediates; only the others use the BigInteger
+    // fields. Every value that fits is stored small, so equal values have equal
+    // representations.
+    int64_t smallNumerator = 0;
+    int64_t smallDenominator = 1;
+    bool small = true;
     BigInteger numerator = 0;
-    BigInteger denominator = 0;
+    BigInteger denominator = 1;
+
+    static bool fitsWord(__int128 value) {
+        return value > INT64_MIN && value <= INT64_MAX;
+    }
+
+    void promote() {
+        if (small) {
+            numerator = BigInteger::fromWide(smallNumerator);
+            denominator = BigInteger::fromWide(smallDenominator);
+            small = false;
+        }
+    }
+
+    void demote() {
+        if (!small && numerator.toWord(smallNumerator) && denominator.toWord(smallDenominator)) {
+            numerator = 0;
+            denominator = 1;
+            small = true;
+        }
+    }
+
+    void setSmall(__int128 numerator_, __int128 denominator_) {
+        smallNumerator = int64_t(numerator_);
+        smallDenominator = int64_t(denominator_);
+        if (!small) {
+            numerator = 0;
+            denominator = 1;
+            small = true;
+        }
+    }
+
+    void normalize() {
+        if (denominator.sign == -1) {
+            denominator.sign = 1;
+            if (numerator.size() > 0) {
+                numerator.sign *= -1;
+            }
+        }
+        GcdCofactors split = gcdCofactors(numerator, denominator);
+        if (split.gcd != 0 && split.gcd != 1) {
+            numerator = std::move(split.first);
+            denominator = std::move(split.second);
+        }
+        demote();
+    }
+
+    // Henrici's addition (see operator+=) in words; false if the sum does not fit.
+    bool addSmall(int64_t otherNumerator, int64_t otherDenominator) {
+        const int64_t common = std::gcd(smallDenominator, otherDenominator);
+        __int128 sum = __int128(smallNumerator) * (otherDenominator / common) +
+                       __int128(otherNumerator) * (smallDenominator / common);
+        __int128 product = __int128(smallDenominator / common) * otherDenominator;
+        if (sum == 0) {
+            setSmall(0, 1);
+            return true;
+        }
+        if (common != 1) {
+            const int64_t reduction = std::gcd(int64_t(sum % common), common);
+            sum /= reduction;
+            product /= reduction;
+        }
+        if (!fitsWord(sum) || !fitsWord(product)) {
+            return false;
+        }
+        setSmall(sum, product);
+        return true;
+    }
+
+    // Cross-cancelling multiplication (see operator*=) in words; false if the
+    // product does not fit.
+    bool multiplySmall(int64_t otherNumerator, int64_t otherDenominator) {
+        if (smallNumerator == 0 || otherNumerator == 0) {
+            setSmall(0, 1);
+            return true;
+        }
+        const int64_t first = std::gcd(smallNumerator, otherDenominator);
+        const int64_t second = std::gcd(otherNumerator, smallDenominator);
+        const __int128 product = __int128(smallNumerator / first) * (otherNumerator / second);
+        const __int128 denominatorProduct = __int128(smallDenominator / second) * (otherDenominator / first);
+        if (!fitsWord(product) || !fitsWord(denominatorProduct)) {
+            return false;
+        }
+        setSmall(product, denominatorProduct);
+        return true;
+    }
+
+    // Henrici's addition: with g = gcd(b, d), b = g * b' and d = g * d', the sum
+    // a / b + c / d = (a * d' + c * b') / (g * b' * d') only has common factors
+    // with g.
+    void addBig(const BigInteger &otherNumerator, const BigInteger &otherDenominator) {
+        GcdCofactors denominators = gcdCofactors(denominator, otherDenominator);
+        BigInteger sum = numerator * denominators.second + otherNumerator * denominators.first;
+        if (!sum) {
+            setSmall(0, 1);
+            return;
+        }
+        if (denominators.gcd == 1) {
+            denominator *= otherDenominator;
+            numerator = std::move(sum);
+        } else {
+            GcdCofactors common = gcdCofactors(sum, denominators.gcd);
+            numerator = std::move(common.first);
+            denominator = denominators.first * denominators.second * common.second;
+        }
+        demote();
+    }
+
+    // With a = g1 * a', d = g1 * d', c = g2 * c' and b = g2 * b' for the GCDs
+    // g1 of a and d and g2 of c and b, the product (a' * c') / (b' * d') is
+    // already reduced.
+    void multiplyBig(const BigInteger &otherNumerator, const BigInteger &otherDenominator) {
+        GcdCofactors first = gcdCofactors(numerator, otherDenominator);
+        GcdCofactors second = gcdCofactors(otherNumerator, denominator);
+        numerator = first.first * second.first;
+        if (!numerator) {
+            setSmall(0, 1);
+            return;
+        }
+        denominator = second.second * first.second;
+        demote();
+    }
+
+    // numerator_ / denominator_ for denominator_ > 0, reduced here.
+    static Rational fromWide(__int128 numerator_, __int128 denominator_) {
+        Rational result;
+        const __int128 rest = numerator_ % denominator_;
+        __int128 a = denominator_;
+        __int128 b = rest < 0 ? -rest : rest;
+        while (b != 0) {
+            __int128 next = a % b;
+            a = b;
+            b = next;
+        }
+        numerator_ /= a;
+        denominator_ /= a;
+        if (fitsWord(numerator_) && fitsWord(denominator_)) {
+            result.setSmall(numerator_, denominator_);
+        } else {
+            result.numerator = BigInteger::fromWide(numerator_);
+            result.denominator = BigInteger::fromWide(denominator_);
+            result.small = false;
+        }
+        return result;
+    }
+
+    // Rounds quotient * 2^-shift, increased by less than one unit of quotient when
+    // inexact, to the nearest double, ties to even. quotient has 55 or 56 bits,
+    // so at least two bits are dropped even from a normal result; a subnormal
+    // result keeps only the bits from 2^-1074 on.
+    static double roundScaled(uint64_t quotient, bool inexact, int64_t shift, bool negative) {
+        const int64_t top = 63 - __builtin_clzll(quotient) - shift;
+        const int64_t lowest = std::max<int64_t>(top - 52, -1074);
+        const int64_t dropped = lowest + shift;
+        double result = 0;
+        if (dropped < 64) {
+            uint64_t mantissa = quotient >> dropped;
+            const uint64_t rest = quotient & ((uint64_t(1) << dropped) - 1);
+            const uint64_t half = uint64_t(1) << (dropped - 1);
+            if (rest > half || (rest == half && (inexact || (mantissa & 1)))) {
+                ++mantissa;
+            }
+            result = std::ldexp(double(mantissa), int(lowest));
+        }
+        return negative ? -result : result;
+    }
+
+    // |numerator| / denominator correctly rounded: both are shifted so that
+    // their quotient has 55 or 56 bits, and one division gives these bits and
+    // whether anything is left. Quotients beyond the double range give
+    // infinity or zero without dividing.
+    double toDouble() const {
+        if (small) {
+            const uint64_t magnitude = smallNumerator < 0 ? uint64_t(-smallNumerator) : uint64_t(smallNumerator);
+            const uint64_t divisor = uint64_t(smallDenominator);
+            if (magnitude < (uint64_t(1) << 53) && divisor < (uint64_t(1) << 53)) {
+                return double(smallNumerator) / double(smallDenominator);
+            }
+            const int64_t shift = 55 - (__builtin_clzll(divisor) - __builtin_clzll(magnitude));
+            const unsigned __int128 dividend = shift >= 0 ? (unsigned __int128)(magnitude) << shift : magnitude;
+            const unsigned __int128 scaledDivisor = shift >= 0 ? (unsigned __int128)(divisor) : (unsigned __int128)(divisor) << -shift;
+            return roundScaled(uint64_t(dividend / scaledDivisor), dividend % scaledDivisor != 0, shift, smallNumerator < 0);
+        }
+        const bool negative = numerator.sign == -1;
+        const int64_t exponent = int64_t(numerator.bitLength()) - int64_t(denominator.bitLength());
+        if (exponent > 1025) {
+            return negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+        }
+        if (exponent < -1080) {
+            return negative ? -0.0 : 0.0;
+        }
+        const int64_t shift = 55 - exponent;
+        BigInteger magnitude = negative ? -numerator : numerator;
+        std::pair<BigInteger, BigInteger> division = shift >= 0
+            ? divmod(magnitude.shiftedBits(size_t(shift)), denominator)
+            : divmod(magnitude, denominator.shiftedBits(size_t(-shift)));
+        return roundScaled(uint64_t(wordValue(division.first.digits.data(), division.first.size())),
+                           division.second.size() > 0, shift, negative);
+    }
 
 public:
     Rational() = default;
 
-    Rational(const int &number) : numerator(number), denominator(1) {}
+    Rational(const int &number) : smallNumerator(number) {}
+
+    Rational(const BigInteger &number) : numerator(number), denominator(1) {
+        small = false;
+        demote();
+    }
 
-    Rational(const BigInteger &number) : numerator(number), denominator(1) {}
+    Rational(const BigInteger &numerator_, const BigInteger &denominator_) : numerator(numerator_), denominator(denominator_) {
+        small = false;
+        normalize();
+    }
 
     BigInteger getNumerator() const {
-        return numerator;
+        return small ? BigInteger::fromWide(smallNumerator) : numerator;
     }
 
     BigInteger getDenominator() const {
-        return denominator;
+        return small ? BigInteger::fromWide(smallDenominator) : denominator;
+    }
+
+    // Limbs of the numerator and the denominator, 0 while the value is word-sized.
+    size_t limbs() const {
+        return small ? 0 : numerator.limbs() + denominator.limbs();
     }
 
     Rational operator-() const {
         Rational copy = *this;
-        if (numerator.size > 0) {
+        if (small) {
+            copy.smallNumerator = -smallNumerator;
+        } else if (numerator.size() > 0) {
             copy.numerator.sign *= -1;
         }
         return copy;
     }
 
     Rational &operator+=(const Rational &another) {
-        numerator = (numerator * another.denominator + denominator * another.numerator);
-        denominator = denominator * another.denominator;
-        BigInteger copyN = numerator;
-        BigInteger copyM = denominator;
-        copyN.sign = 1;
-        copyM.sign = 1;
-        BigInteger gcd = (copyN > copyM ? GCD(copyN, copyM) : GCD(copyM, copyN));
-        gcd.sign = 1;
-        numerator /= gcd;
-        denominator /= gcd;
+        if (small && another.small && addSmall(another.smallNumerator, another.smallDenominator)) {
+            return *this;
+        }
+        if (another.small) {
+            const BigInteger otherNumerator = another.getNumerator();
+            const BigInteger otherDenominator = another.getDenominator();
+            promote();
+            addBig(otherNumerator, otherDenominator);
+        } else {
+            promote();
+            addBig(another.numerator, another.denominator);
+        }
         return *this;
     }
 
     Rational &operator-=(const Rational &another) {
-        Rational copy = another;
-        if (another.numerator.size > 0) copy.numerator.sign *= -1;
-        *this += copy;
+        *this += -another;
         return *this;
     }
 
     Rational &operator*=(const Rational &another) {
-        numerator *= another.numerator;
-        denominator *= another.denominator;
-        BigInteger copyN = numerator;
-        BigInteger copyM = denominator;
-        copyN.sign = 1;
-        copyM.sign = 1;
-        BigInteger gcd = (copyN > copyM ? GCD(copyN, copyM) : GCD(copyM, copyN));
-        gcd.sign = 1;
-        numerator /= gcd;
-        denominator /= gcd;
+        if (small && another.small && multiplySmall(another.smallNumerator, another.smallDenominator)) {
+            return *this;
+        }
+        if (another.small) {
+            const BigInteger otherNumerator = another.getNumerator();
+            const BigInteger otherDenominator = another.getDenominator();
+            promote();
+            multiplyBig(otherNumerator, otherDenominator);
+        } else {
+            promote();
+            multiplyBig(another.numerator, another.denominator);
+        }
         return *this;
     }
 
     Rational &operator/=(const Rational &another) {
         Rational copy = another;
+        copy.promote();
         std::swap(copy.numerator, copy.denominator);
         if (copy.denominator.sign == -1) {
             copy.numerator.sign = -1;
             copy.denominator.sign = 1;
         }
+        copy.demote();
         *this *= copy;
         return *this;
     }
 
     std::string toString() const {
+        if (small) {
+            std::string result = std::to_string(smallNumerator);
+            if (smallDenominator != 1) {
+                result += '/';
+                result += std::to_string(smallDenominator);
+            }
+            return result;
+        }
         std::string result = numerator.toString();
         if (denominator != 1) {
             result += '/';
@@ -95,84 +337,144 @@ public:
         return result;
     }
 
+    // All digits come from one division: |numerator| * 10^precision / denominator.
     std::string asDecimal(size_t precision = 0) const {
-        std::string result;
-        if (numerator == 0) {
-            result += '0';
-            if (precision > 0) {
-                result += '.';
-                for (size_t i = 0; i < precision; ++i) {
-                    result += '0';
-                }
-            }
-            return result;
-        }
-        Rational z = numerator / denominator;
-        if (z == 0 && numerator.sign == -1) {
-            result += '-';
+        const BigInteger value = getNumerator();
+        BigInteger scaled = value.sign == -1 ? -value : value;
+        scaled *= powerOfTen(precision);
+        std::string digits = (scaled / getDenominator()).toString();
+        if (digits.size() <= precision) {
+            digits.insert(0, precision + 1 - digits.size(), '0');
         }
-        result += z.toString();
+        std::string result = value.sign == -1 ? "-" : "";
+        result.append(digits, 0, digits.size() - precision);
         if (precision > 0) {
             result += '.';
-        } else {
-            return result;
+            result.append(digits, digits.size() - precision, precision);
         }
-        size_t pred = result.size();
-        BigInteger now = numerator % denominator;
-        now.sign = 1;
-        BigInteger residue = 0;
-        for (size_t i = 0; i < (precision + BASE_CNT - 1) / BASE_CNT; ++i) {
-            now = now * BASE;
-            if (now >= denominator) {
-                int leftQuotient = 0;
-                int rightQuotient = BASE;
-                while (rightQuotient - leftQuotient > 1) {
-                    int quotient = leftQuotient + (rightQuotient - leftQuotient) / 2;
-                    denominator * quotient <= now ? leftQuotient = quotient : rightQuotient = quotient;
-                }
-                residue.digits.push_back(leftQuotient);
-                now -= denominator * leftQuotient;
-            } else {
-                residue.digits.push_back(0);
+        return result;
+    }
+
+    friend class RationalAccumulator;
+    friend bool operator==(const Rational &first, const Rational &second);
+    friend bool operator<(const Rational &first, const Rational &second);
+
+    explicit operator double() const {
+        return toDouble();
+    }
+};
+
+// A sum of Rationals and products of Rationals that is reduced only once,
+// when it is read. While the terms are words, the sum is kept as a 128-bit
+// numerator over a word denominator that grows to the least common multiple
+// of the denominators of the terms, and a term with the same denominator is a
+// single addition. Whatever does not fit into words goes to an ordinary
+// Rational sum.
+class RationalAccumulator {
+private:
+    __int128 numerator = 0;
+    int64_t denominator = 1;
+    Rational rest = 0;
+
+    bool addWords(__int128 termNumerator, __int128 termDenominator) {
+        // Overflow leaves numerator and denominator as they were; add() flushes
+        // them to rest.
+        if (termDenominator == denominator) {
+            __int128 sum = 0;
+            if (__builtin_add_overflow(numerator, termNumerator, &sum)) {
+                return false;
             }
+            numerator = sum;
+            return true;
         }
-        residue.size = residue.digits.size();
-        int tmp = residue.digits[0];
-        size_t cnt = 0;
-        while (tmp > 0) {
-            tmp /= 10;
-            cnt++;
+        if (termDenominator > INT64_MAX) {
+            return false;
         }
-        for (size_t i = 0; i < BASE_CNT - cnt; ++i) {
-            result += '0';
+        const int64_t common = std::gcd(denominator, int64_t(termDenominator));
+        const int64_t ownScale = int64_t(termDenominator) / common;
+        const int64_t termScale = denominator / common;
+        int64_t lcm = 0;
+        __int128 scaled = 0;
+        __int128 scaledTerm = 0;
+        if (__builtin_mul_overflow(denominator, ownScale, &lcm) ||
+            __builtin_mul_overflow(numerator, ownScale, &scaled) ||
+            __builtin_mul_overflow(termNumerator, termScale, &scaledTerm) ||
+            __builtin_add_overflow(scaled, scaledTerm, &scaled)) {
+            return false;
         }
-        for (size_t i = 0; i < residue.size / 2; ++i) {
-            std::swap(residue.digits[i], residue.digits[residue.size - i - 1]);
+        numerator = scaled;
+        denominator = lcm;
+        return true;
+    }
+
+    void add(__int128 termNumerator, __int128 termDenominator) {
+        if (addWords(termNumerator, termDenominator)) {
+            return;
         }
-        residue.sign = 1;
-        result += residue.toString();
-        while (result.size() > pred + precision) {
-            result.pop_back();
+        rest += Rational::fromWide(numerator, denominator);
+        numerator = 0;
+        denominator = 1;
+        if (!addWords(termNumerator, termDenominator)) {
+            rest += Rational::fromWide(termNumerator, termDenominator);
         }
-        return result;
     }
 
-    explicit operator double() const {
-        size_t precision = 100;
-        std::string result = (*this).asDecimal(precision);
-        double ans = 0;
-        for (char digit : result) {
-            if (digit != '-' && digit != '.') {
-                ans = ans * 10 + (digit - '0');
-            }
+    // The first long term is moved into rest instead of being added to zero.
+    void addRest(Rational term, bool negative) {
+        if (negative) {
+            term = -term;
+        }
+        if (rest.small && rest.smallNumerator == 0) {
+            rest = std::move(term);
+        } else {
+            rest += term;
         }
-        for (size_t i = 0; i < precision; ++i) {
-            ans /= 10;
+    }
+
+public:
+    void add(const Rational &value) {
+        if (value.small) {
+            add(value.smallNumerator, value.smallDenominator);
+        } else {
+            addRest(value, false);
         }
-        if (numerator.sign == -1) {
-            ans *= -1;
+    }
+
+    void subtract(const Rational &value) {
+        if (value.small) {
+            add(-__int128(value.smallNumerator), value.smallDenominator);
+        } else {
+            addRest(value, true);
         }
-        return ans;
+    }
+
+    void addProduct(const Rational &first, const Rational &second) {
+        if (first.small && second.small) {
+            add(__int128(first.smallNumerator) * second.smallNumerator,
+                __int128(first.smallDenominator) * second.smallDenominator);
+        } else {
+            addRest(first * second, false);
+        }
+    }
+
+    void subtractProduct(const Rational &first, const Rational &second) {
+        if (first.small && second.small) {
+            add(-__int128(first.smallNumerator) * second.smallNumerator,
+                __int128(first.smallDenominator) * second.smallDenominator);
+        } else {
+            addRest(first * second, true);
+        }
+    }
+
+    Rational value() const {
+        if (numerator == 0) {
+            return rest;
+        }
+        Rational result = Rational::fromWide(numerator, denominator);
+        if (rest != 0) {
+            result += rest;
+        }
+        return result;
     }
 };
 
@@ -201,7 +503,11 @@ Rational operator/(const Rational &first, const Rational &second) {
 }
 
 bool operator==(const Rational &first, const Rational &second) {
-    return first.getNumerator() == second.getNumerator() && first.getDenominator() == second.getDenominator();
+    if (first.small || second.small) {
+        return first.small && second.small && first.smallNumerator == second.smallNumerator &&
+               first.smallDenominator == second.smallDenominator;
+    }
+    return first.numerator == second.numerator && first.denominator == second.denominator;
 }
 
 bool operator!=(const Rational &first, const Rational &second) {
@@ -209,9 +515,13 @@ bool operator!=(const Rational &first, const Rational &second) {
 }
 
 bool operator<(const Rational &first, const Rational &second) {
+    if (first.small && second.small) {
+        return __int128(first.smallNumerator) * second.smallDenominator <
+               __int128(second.smallNumerator) * first.smallDenominator;
+    }
     Rational difference = first;
     difference -= second;
-    return difference.getNumerator() < 0;
+    return difference.small ? difference.smallNumerator < 0 : difference.numerator.sign == -1;
 }
 
 bool operator>(const Rational &first, const Rational &second) {
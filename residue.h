@@ -1,13 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 int binPow(int number, size_t pow, size_t MOD) {
-    if (pow == 0) {
-        return 1;
+    int64_t base = number % int64_t(MOD);
+    if (base < 0) {
+        base += int64_t(MOD);
     }
-    if (pow & 1) {
-        return int((1LL * number * binPow(number, pow - 1, MOD)) % MOD);
-    } else {
-        long long tmp = binPow(number, pow / 2, MOD);
-        return int((tmp * tmp) % MOD);
+    int64_t result = int64_t(1 % MOD);
+    while (pow > 0) {
+        if (pow & 1) {
+            result = result * base % int64_t(MOD);
+        }
+        base = base * base % int64_t(MOD);
+        pow >>= 1;
     }
+    return int(result);
 }
 
 template<size_t V, size_t LeftBound, size_t RightBound>
@@ -28,30 +39,67 @@ struct Sqrt {
     static const size_t value = SqrtHelper<N, 0, N>::value;
 };
 
-template<size_t N, size_t Divisor>
-struct IsPrimeHelper {
-    static const bool value = (N % Divisor != 0 && IsPrimeHelper<N, Divisor - 1>::value);
-};
+constexpr bool hasDivisorUpTo(size_t number, size_t bound) {
+    for (size_t divisor = 2; divisor <= bound; ++divisor) {
+        if (number % divisor == 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
 template<size_t N>
-struct IsPrimeHelper<N, 1> {
-    static const bool value = true;
+struct IsPrime {
+    static const bool value = !hasDivisorUpTo(N, Sqrt<N>::value);
 };
 
+// Barrett reduction: with factor = floor((2^64 - 1) / modulus) the quotient
+// x / modulus is estimated as (x * factor) >> 64, at most two less than the exact one.
+uint64_t barrettReduce(uint64_t x, uint64_t modulus, uint64_t factor) {
+    uint64_t quotient = uint64_t((static_cast<unsigned __int128>(x) * factor) >> 64);
+    uint64_t remainder = x - quotient * modulus;
+    while (remainder >= modulus) {
+        remainder -= modulus;
+    }
+    return remainder;
+}
+
+// Compile-time Barrett constants for the modulus N.
 template<size_t N>
-struct IsPrime {
-    static const bool value = IsPrimeHelper<N, Sqrt<N>::value>::value;
+struct ModularReduction {
+    static_assert(N > 0 && N <= 2147483647);
+
+    static constexpr uint64_t factor = ~uint64_t(0) / N;
+    static constexpr uint64_t twoTo64 = (~uint64_t(0) % N + 1) % N;
+    // Number of products of two residues that can be added to a residue
+    // without overflowing 64 bits.
+    static constexpr uint64_t lazyTerms = N == 1 ? ~uint64_t(0) : (~uint64_t(0) - N) / ((N - 1) * (N - 1));
+
+    static uint64_t reduce(uint64_t x) {
+        return barrettReduce(x, N, factor);
+    }
+
+    static uint64_t reduce(unsigned __int128 x) {
+        uint64_t high = reduce(uint64_t(x >> 64));
+        return reduce(high * twoTo64 + reduce(uint64_t(x)));
+    }
 };
 
 template<size_t N>
 class Residue {
 private:
+    using Reduction = ModularReduction<N>;
+
+    struct Reduced {};
+
     int value = 0;
 
+    Residue(uint64_t value_, Reduced) : value(int(value_)) {}
+
 public:
-    explicit Residue(int value_) : value(value_ % static_cast<int>(N)) {
-        if (value < 0) {
-            value += N;
+    explicit Residue(int value_) : value(int(Reduction::reduce(uint64_t(value_ < 0 ? -int64_t(value_) : value_)))) {
+        if (value_ < 0 && value != 0) {
+            value = int(N) - value;
         }
     }
 
@@ -64,20 +112,57 @@ public:
     }
 
     Residue operator+(const Residue &another) const {
-        return Residue((value + another.value) % N);
+        uint64_t sum = uint64_t(value) + uint64_t(another.value);
+        return Residue(sum >= N ? sum - N : sum, Reduced());
     }
 
     Residue operator-(const Residue &another) const {
-        return Residue((value - another.value + N) % N);
+        int64_t difference = int64_t(value) - another.value;
+        return Residue(uint64_t(difference < 0 ? difference + int64_t(N) : difference), Reduced());
     }
 
     Residue operator*(const Residue &another) const {
-        return Residue((1LL * value * another.value) % N);
+        return Residue(Reduction::reduce(uint64_t(value) * uint64_t(another.value)), Reduced());
     }
 
     Residue operator/(const Residue &another) const {
+        return *this * another.inverse();
+    }
+
+    // Extended Euclid on (value, N); the cofactor of value is its inverse.
+    Residue inverse() const {
         static_assert(IsPrime<N>::value);
-        return Residue((1LL * value * binPow(another.value, N - 2, N)) % N);
+        int64_t a = value;
+        int64_t b = int64_t(N);
+        int64_t x = 1;
+        int64_t y = 0;
+        while (b != 0) {
+            int64_t quotient = a / b;
+            a -= quotient * b;
+            std::swap(a, b);
+            x -= quotient * y;
+            std::swap(x, y);
+        }
+        return Residue(uint64_t(x < 0 ? x + int64_t(N) : x), Reduced());
+    }
+
+    // Montgomery's trick: replaces every value by its inverse with a single
+    // inversion and 3 * (count - 1) multiplications. All values must be non-zero.
+    static void batchInverse(Residue *values, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        std::vector<Residue> prefix(count, values[0]);
+        for (size_t i = 1; i < count; ++i) {
+            prefix[i] = prefix[i - 1] * values[i];
+        }
+        Residue inverted = prefix[count - 1].inverse();
+        for (size_t i = count - 1; i > 0; --i) {
+            Residue current = values[i];
+            values[i] = inverted * prefix[i - 1];
+            inverted *= current;
+        }
+        values[0] = inverted;
     }
 
     Residue &operator+=(const Residue &another) {
@@ -104,4 +189,26 @@ public:
         return value;
     }
 
+    // The products are summed in 64 bits and reduced once every lazyTerms
+    // terms; for moduli close to 2^31 they are summed in 128 bits instead.
+    static Residue dotProduct(const Residue *first, const Residue *second, size_t length) {
+        if constexpr (Reduction::lazyTerms >= 8) {
+            uint64_t sum = 0;
+            size_t i = 0;
+            while (i < length) {
+                size_t end = length - i > Reduction::lazyTerms ? i + Reduction::lazyTerms : length;
+                for (; i < end; ++i) {
+                    sum += uint64_t(first[i].value) * uint64_t(second[i].value);
+                }
+                sum = Reduction::reduce(sum);
+            }
+            return Residue(sum, Reduced());
+        } else {
+            unsigned __int128 sum = 0;
+            for (size_t i = 0; i < length; ++i) {
+                sum += uint64_t(first[i].value) * uint64_t(second[i].value);
+            }
+            return Residue(Reduction::reduce(sum), Reduced());
+        }
+    }
 };
\ No newline at end of file
@@ -0,0 +1,434 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Vectorized arithmetic modulo a runtime modulus below 2^31 on arrays of
+// reduced 32-bit residues. The instruction set is chosen at runtime; every
+// function returns false when no vector unit is available, the caller then
+// falls back to its scalar loop.
+enum class SimdLevel {
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+SimdLevel detectSimdLevel() {
+#ifdef MATRIX_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel &simdLevel() {
+    static SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+// Restricts the kernels to the given instruction set; levels the processor
+// does not support are ignored.
+void setSimdLevel(SimdLevel level) {
+    simdLevel() = level < detectSimdLevel() ? level : detectSimdLevel();
+}
+
+// floor(multiplier * 2^32 / modulus), used by Shoup's modular multiplication:
+// for x < 2^32 the value x * multiplier - mulhi(x, shoup) * modulus lies in [0, 2 * modulus).
+uint32_t shoupFactor(uint32_t multiplier, uint32_t modulus) {
+    return uint32_t((uint64_t(multiplier) << 32) / modulus);
+}
+
+#ifdef MATRIX_SIMD_X86
+
+__attribute__((target("avx2")))
+inline __m256i multiplyShoupAvx2(__m256i x, __m256i multiplier, __m256i shoup, __m256i modulus) {
+    __m256i even = _mm256_mul_epu32(x, shoup);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(shoup, 32));
+    __m256i quotient = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    __m256i remainder = _mm256_sub_epi32(_mm256_mullo_epi32(x, multiplier), _mm256_mullo_epi32(quotient, modulus));
+    return _mm256_min_epu32(remainder, _mm256_sub_epi32(remainder, modulus));
+}
+
+__attribute__((target("avx2")))
+void addModularAvx2(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t modulus) {
+    const __m256i mod = _mm256_set1_epi32(int(modulus));
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m256i sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(x + i)),
+                                       _mm256_loadu_si256((const __m256i *)(y + i)));
+        _mm256_storeu_si256((__m256i *)(z + i), _mm256_min_epu32(sum, _mm256_sub_epi32(sum, mod)));
+    }
+    for (; i < length; ++i) {
+        uint32_t sum = x[i] + y[i];
+        z[i] = sum >= modulus ? sum - modulus : sum;
+    }
+}
+
+__attribute__((target("avx2")))
+void subtractModularAvx2(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t modulus) {
+    const __m256i mod = _mm256_set1_epi32(int(modulus));
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m256i difference = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(x + i)),
+                                              _mm256_loadu_si256((const __m256i *)(y + i)));
+        _mm256_storeu_si256((__m256i *)(z + i), _mm256_min_epu32(difference, _mm256_add_epi32(difference, mod)));
+    }
+    for (; i < length; ++i) {
+        z[i] = x[i] >= y[i] ? x[i] - y[i] : x[i] + modulus - y[i];
+    }
+}
+
+__attribute__((target("avx2")))
+void scaleModularAvx2(const uint32_t *x, uint32_t multiplier, uint32_t *z, size_t length, uint32_t modulus) {
+    const uint32_t shoup = shoupFactor(multiplier, modulus);
+    const __m256i mod = _mm256_set1_epi32(int(modulus));
+    const __m256i mul = _mm256_set1_epi32(int(multiplier));
+    const __m256i sho = _mm256_set1_epi32(int(shoup));
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m256i value = _mm256_loadu_si256((const __m256i *)(x + i));
+        _mm256_storeu_si256((__m256i *)(z + i), multiplyShoupAvx2(value, mul, sho, mod));
+    }
+    for (; i < length; ++i) {
+        z[i] = uint32_t(uint64_t(x[i]) * multiplier % modulus);
+    }
+}
+
+__attribute__((target("avx2")))
+void subtractMultipleModularAvx2(uint32_t *row, const uint32_t *another, uint32_t multiplier, size_t length,
+                                 uint32_t modulus) {
+    const uint32_t shoup = shoupFactor(multiplier, modulus);
+    const __m256i mod = _mm256_set1_epi32(int(modulus));
+    const __m256i mul = _mm256_set1_epi32(int(multiplier));
+    const __m256i sho = _mm256_set1_epi32(int(shoup));
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m256i product = multiplyShoupAvx2(_mm256_loadu_si256((const __m256i *)(another + i)), mul, sho, mod);
+        __m256i difference = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(row + i)), product);
+        _mm256_storeu_si256((__m256i *)(row + i), _mm256_min_epu32(difference, _mm256_add_epi32(difference, mod)));
+    }
+    for (; i < length; ++i) {
+        uint32_t product = uint32_t(uint64_t(another[i]) * multiplier % modulus);
+        row[i] = row[i] >= product ? row[i] - product : row[i] + modulus - product;
+    }
+}
+
+// The 64-bit products are split into their 32-bit halves, which are summed
+// separately, so the lanes cannot overflow.
+__attribute__((target("avx2")))
+unsigned __int128 dotAvx2(const uint32_t *x, const uint32_t *y, size_t length) {
+    const __m256i lowMask = _mm256_set1_epi64x(0xFFFFFFFF);
+    __m256i low = _mm256_setzero_si256();
+    __m256i high = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(x + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(y + i));
+        __m256i even = _mm256_mul_epu32(a, b);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+        low = _mm256_add_epi64(low, _mm256_add_epi64(_mm256_and_si256(even, lowMask), _mm256_and_si256(odd, lowMask)));
+        high = _mm256_add_epi64(high, _mm256_add_epi64(_mm256_srli_epi64(even, 32), _mm256_srli_epi64(odd, 32)));
+    }
+    alignas(32) uint64_t lows[4];
+    alignas(32) uint64_t highs[4];
+    _mm256_store_si256((__m256i *)lows, low);
+    _mm256_store_si256((__m256i *)highs, high);
+    unsigned __int128 sum = 0;
+    for (size_t j = 0; j < 4; ++j) {
+        sum += lows[j] + (static_cast<unsigned __int128>(highs[j]) << 32);
+    }
+    for (; i < length; ++i) {
+        sum += uint64_t(x[i]) * y[i];
+    }
+    return sum;
+}
+
+// Carry propagation across the eight 32-bit lanes of a block of limbs: lane i
+// generates a carry (bit i of generated) or passes an incoming one on (bit i
+// of propagated, the lane is all ones); generated + (generated | propagated)
+// + carry then carries into bit i exactly when lane i receives a carry, so the
+// carries into the lanes are the bits of that sum xor propagated and bit 8 is
+// the carry out of the block. The same holds for borrows.
+__attribute__((target("avx2")))
+inline __m256i laneCarriesAvx2(uint32_t generated, uint32_t propagated, uint32_t &carry) {
+    const uint32_t sum = generated + (generated | propagated) + carry;
+    carry = sum >> 8;
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    return _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(int((sum ^ propagated) & 0xFF)), lanes),
+                            _mm256_set1_epi32(1));
+}
+
+// z = x + y + carry over length limbs; returns the carry out.
+__attribute__((target("avx2")))
+uint32_t addLimbsAvx2(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t carry) {
+    const __m256i flip = _mm256_set1_epi32(INT32_MIN);
+    const __m256i ones = _mm256_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(x + i));
+        const __m256i sum = _mm256_add_epi32(a, _mm256_loadu_si256((const __m256i *)(y + i)));
+        const __m256i generated = _mm256_cmpgt_epi32(_mm256_xor_si256(a, flip), _mm256_xor_si256(sum, flip));
+        const __m256i propagated = _mm256_cmpeq_epi32(sum, ones);
+        const __m256i carries = laneCarriesAvx2(uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(generated))),
+                                                uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(propagated))), carry);
+        _mm256_storeu_si256((__m256i *)(z + i), _mm256_add_epi32(sum, carries));
+    }
+    for (; i < length; ++i) {
+        const uint64_t sum = uint64_t(x[i]) + y[i] + carry;
+        z[i] = uint32_t(sum);
+        carry = uint32_t(sum >> 32);
+    }
+    return carry;
+}
+
+// z = x - y - borrow over length limbs; returns the borrow out.
+__attribute__((target("avx2")))
+uint32_t subtractLimbsAvx2(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t borrow) {
+    const __m256i flip = _mm256_set1_epi32(INT32_MIN);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(x + i));
+        const __m256i b = _mm256_loadu_si256((const __m256i *)(y + i));
+        const __m256i difference = _mm256_sub_epi32(a, b);
+        const __m256i generated = _mm256_cmpgt_epi32(_mm256_xor_si256(b, flip), _mm256_xor_si256(a, flip));
+        const __m256i propagated = _mm256_cmpeq_epi32(difference, _mm256_setzero_si256());
+        const __m256i borrows = laneCarriesAvx2(uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(generated))),
+                                                uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(propagated))), borrow);
+        _mm256_storeu_si256((__m256i *)(z + i), _mm256_sub_epi32(difference, borrows));
+    }
+    for (; i < length; ++i) {
+        const uint64_t difference = uint64_t(x[i]) - y[i] - borrow;
+        z[i] = uint32_t(difference);
+        borrow = uint32_t(difference >> 63);
+    }
+    return borrow;
+}
+
+// Compares x and y of length limbs from the most significant end; returns
+// -1, 0 or 1.
+__attribute__((target("avx2")))
+int compareLimbsAvx2(const uint32_t *x, const uint32_t *y, size_t length) {
+    size_t i = length;
+    for (; i >= 8; i -= 8) {
+        const __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(x + i - 8)),
+                                                 _mm256_loadu_si256((const __m256i *)(y + i - 8)));
+        const uint32_t mask = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(equal))) ^ 0xFF;
+        if (mask != 0) {
+            const size_t lane = i - 8 + size_t(31 - __builtin_clz(mask));
+            return x[lane] < y[lane] ? -1 : 1;
+        }
+    }
+    while (i-- > 0) {
+        if (x[i] != y[i]) {
+            return x[i] < y[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// The AVX-512 intrinsics of GCC 12 start from _mm512_undefined_epi32(), which
+// -Wmaybe-uninitialized reports as a use of an uninitialized value.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+inline __m512i multiplyShoupAvx512(__m512i x, __m512i multiplier, __m512i shoup, __m512i modulus) {
+    __m512i even = _mm512_mul_epu32(x, shoup);
+    __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), _mm512_srli_epi64(shoup, 32));
+    __m512i quotient = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+    __m512i remainder = _mm512_sub_epi32(_mm512_mullo_epi32(x, multiplier), _mm512_mullo_epi32(quotient, modulus));
+    return _mm512_min_epu32(remainder, _mm512_sub_epi32(remainder, modulus));
+}
+
+__attribute__((target("avx512f")))
+void addModularAvx512(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t modulus) {
+    const __m512i mod = _mm512_set1_epi32(int(modulus));
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m512i sum = _mm512_add_epi32(_mm512_loadu_si512(x + i), _mm512_loadu_si512(y + i));
+        _mm512_storeu_si512(z + i, _mm512_min_epu32(sum, _mm512_sub_epi32(sum, mod)));
+    }
+    addModularAvx2(x + i, y + i, z + i, length - i, modulus);
+}
+
+__attribute__((target("avx512f")))
+void subtractModularAvx512(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t modulus) {
+    const __m512i mod = _mm512_set1_epi32(int(modulus));
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m512i difference = _mm512_sub_epi32(_mm512_loadu_si512(x + i), _mm512_loadu_si512(y + i));
+        _mm512_storeu_si512(z + i, _mm512_min_epu32(difference, _mm512_add_epi32(difference, mod)));
+    }
+    subtractModularAvx2(x + i, y + i, z + i, length - i, modulus);
+}
+
+__attribute__((target("avx512f")))
+void scaleModularAvx512(const uint32_t *x, uint32_t multiplier, uint32_t *z, size_t length, uint32_t modulus) {
+    const uint32_t shoup = shoupFactor(multiplier, modulus);
+    const __m512i mod = _mm512_set1_epi32(int(modulus));
+    const __m512i mul = _mm512_set1_epi32(int(multiplier));
+    const __m512i sho = _mm512_set1_epi32(int(shoup));
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        _mm512_storeu_si512(z + i, multiplyShoupAvx512(_mm512_loadu_si512(x + i), mul, sho, mod));
+    }
+    scaleModularAvx2(x + i, multiplier, z + i, length - i, modulus);
+}
+
+__attribute__((target("avx512f")))
+void subtractMultipleModularAvx512(uint32_t *row, const uint32_t *another, uint32_t multiplier, size_t length,
+                                   uint32_t modulus) {
+    const uint32_t shoup = shoupFactor(multiplier, modulus);
+    const __m512i mod = _mm512_set1_epi32(int(modulus));
+    const __m512i mul = _mm512_set1_epi32(int(multiplier));
+    const __m512i sho = _mm512_set1_epi32(int(shoup));
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m512i product = multiplyShoupAvx512(_mm512_loadu_si512(another + i), mul, sho, mod);
+        __m512i difference = _mm512_sub_epi32(_mm512_loadu_si512(row + i), product);
+        _mm512_storeu_si512(row + i, _mm512_min_epu32(difference, _mm512_add_epi32(difference, mod)));
+    }
+    subtractMultipleModularAvx2(row + i, another + i, multiplier, length - i, modulus);
+}
+
+__attribute__((target("avx512f")))
+unsigned __int128 dotAvx512(const uint32_t *x, const uint32_t *y, size_t length) {
+    const __m512i lowMask = _mm512_set1_epi64(0xFFFFFFFF);
+    __m512i low = _mm512_setzero_si512();
+    __m512i high = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m512i a = _mm512_loadu_si512(x + i);
+        __m512i b = _mm512_loadu_si512(y + i);
+        __m512i even = _mm512_mul_epu32(a, b);
+        __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+        low = _mm512_add_epi64(low, _mm512_add_epi64(_mm512_and_si512(even, lowMask), _mm512_and_si512(odd, lowMask)));
+        high = _mm512_add_epi64(high, _mm512_add_epi64(_mm512_srli_epi64(even, 32), _mm512_srli_epi64(odd, 32)));
+    }
+    alignas(64) uint64_t lows[8];
+    alignas(64) uint64_t highs[8];
+    _mm512_store_si512(lows, low);
+    _mm512_store_si512(highs, high);
+    unsigned __int128 sum = 0;
+    for (size_t j = 0; j < 8; ++j) {
+        sum += lows[j] + (static_cast<unsigned __int128>(highs[j]) << 32);
+    }
+    return sum + dotAvx2(x + i, y + i, length - i);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+bool addModularSimd(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t modulus) {
+#ifdef MATRIX_SIMD_X86
+    if (simdLevel() == SimdLevel::AVX512) {
+        addModularAvx512(x, y, z, length, modulus);
+        return true;
+    }
+    if (simdLevel() == SimdLevel::AVX2) {
+        addModularAvx2(x, y, z, length, modulus);
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool subtractModularSimd(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t modulus) {
+#ifdef MATRIX_SIMD_X86
+    if (simdLevel() == SimdLevel::AVX512) {
+        subtractModularAvx512(x, y, z, length, modulus);
+        return true;
+    }
+    if (simdLevel() == SimdLevel::AVX2) {
+        subtractModularAvx2(x, y, z, length, modulus);
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool scaleModularSimd(const uint32_t *x, uint32_t multiplier, uint32_t *z, size_t length, uint32_t modulus) {
+#ifdef MATRIX_SIMD_X86
+    if (simdLevel() == SimdLevel::AVX512) {
+        scaleModularAvx512(x, multiplier, z, length, modulus);
+        return true;
+    }
+    if (simdLevel() == SimdLevel::AVX2) {
+        scaleModularAvx2(x, multiplier, z, length, modulus);
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool subtractMultipleModularSimd(uint32_t *row, const uint32_t *another, uint32_t multiplier, size_t length,
+                                 uint32_t modulus) {
+#ifdef MATRIX_SIMD_X86
+    if (simdLevel() == SimdLevel::AVX512) {
+        subtractMultipleModularAvx512(row, another, multiplier, length, modulus);
+        return true;
+    }
+    if (simdLevel() == SimdLevel::AVX2) {
+        subtractMultipleModularAvx2(row, another, multiplier, length, modulus);
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool dotSimd(const uint32_t *x, const uint32_t *y, size_t length, unsigned __int128 &sum) {
+#ifdef MATRIX_SIMD_X86
+    if (simdLevel() == SimdLevel::AVX512) {
+        sum = dotAvx512(x, y, length);
+        return true;
+    }
+    if (simdLevel() == SimdLevel::AVX2) {
+        sum = dotAvx2(x, y, length);
+        return true;
+    }
+#endif
+    return false;
+}
+
+// Multi-limb addition, subtraction and comparison of unsigned 32-bit limbs
+// (limbs.h). The AVX2 kernels serve the AVX-512 level as well.
+bool addLimbsSimd(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t &carry) {
+#ifdef MATRIX_SIMD_X86
+    if (simdLevel() != SimdLevel::Scalar) {
+        carry = addLimbsAvx2(x, y, z, length, carry);
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool subtractLimbsSimd(const uint32_t *x, const uint32_t *y, uint32_t *z, size_t length, uint32_t &borrow) {
+#ifdef MATRIX_SIMD_X86
+    if (simdLevel() != SimdLevel::Scalar) {
+        borrow = subtractLimbsAvx2(x, y, z, length, borrow);
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool compareLimbsSimd(const uint32_t *x, const uint32_t *y, size_t length, int &order) {
+#ifdef MATRIX_SIMD_X86
+    if (simdLevel() != SimdLevel::Scalar) {
+        order = compareLimbsAvx2(x, y, length);
+        return true;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal checks for the test programs: CHECK reports a failed condition with
+// its location and checkResult() turns the number of failures into the exit
+// status.
+
+inline int &checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                       \
+    do {                                                                                       \
+        if (!(condition)) {                                                                    \
+            ++checkFailures();                                                                 \
+            std::cerr << __FILE__ << ':' << __LINE__ << ": CHECK(" #condition ") failed\n";     \
+        }                                                                                      \
+    } while (false)
+
+inline int checkResult(const char *name) {
+    std::cout << name << ": " << (checkFailures() == 0 ? "ok" : "FAILED") << '\n';
+    return checkFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "biginteger.h"
+#include "gcd.h"
+#include "threadpool.h"
+#include "check.h"
+
+// BigInteger arithmetic against known values: limb boundaries and products
+// long enough for Karatsuba and Toom-3, long division, GCD, values moving
+// between inline and heap limbs, and the vector limb kernels against plain
+// carry loops, the divide-and-conquer decimal conversion, and the reuse of
+// limb blocks through LimbPool.
+
+std::mt19937 rng(2);
+
+BigInteger parse(const std::string &digits) {
+    std::istringstream in(digits);
+    BigInteger result;
+    in >> result;
+    return result;
+}
+
+std::string randomDigits(size_t length) {
+    std::string digits(1, char('1' + rng() % 9));
+    while (digits.size() < length) {
+        digits += char('0' + rng() % 10);
+    }
+    return digits;
+}
+
+BigInteger power(const BigInteger &base, int exponent) {
+    BigInteger result = 1;
+    for (int i = 0; i < exponent; ++i) {
+        result *= base;
+    }
+    return result;
+}
+
+void testLimbBoundaries() {
+    const BigInteger word = power(2, 32);
+    CHECK(word.toString() == "4294967296");
+    CHECK((word - 1).toString() == "4294967295");
+    CHECK((word * word).toString() == "18446744073709551616");
+    CHECK(power(2, 128).toString() == "340282366920938463463374607431768211456");
+    BigInteger counter = word * word - 1;
+    ++counter;
+    CHECK(counter == word * word);
+    --counter;
+    CHECK(counter.toString() == "18446744073709551615");
+    CHECK((BigInteger(-7) * BigInteger(6)).toString() == "-42");
+    CHECK((BigInteger(5) - BigInteger(12)).toString() == "-7");
+    CHECK(BigInteger(0).toString() == "0" && (BigInteger(3) - BigInteger(3)).toString() == "0");
+    CHECK(parse("-123456789012345678901234567890").toString() == "-123456789012345678901234567890");
+    CHECK(parse("123456789012345678901234567890").residue(1000000007) == 197434842);
+}
+
+void testLongProducts() {
+    // (10^n - 1)^2 = 10^2n - 2 * 10^n + 1 has the digits 9...98 0...01.
+    for (size_t n : {10, 200, 1500, 6000}) {
+        const BigInteger nines = parse(std::string(n, '9'));
+        const std::string expected = std::string(n - 1, '9') + "8" + std::string(n - 1, '0') + "1";
+        CHECK((nines * nines).toString() == expected);
+    }
+    for (size_t n : {50, 700, 4000}) {
+        const BigInteger a = parse(randomDigits(n));
+        const BigInteger b = parse(randomDigits(n / 2 + 3));
+        const BigInteger c = parse(randomDigits(n / 3 + 1));
+        CHECK(a * (b + c) == a * b + a * c);
+        CHECK((a * b) * c == a * (b * c));
+        CHECK(-a * b == -(a * b));
+    }
+}
+
+void testDivision() {
+    CHECK((power(10, 36) / 7).toString() == "142857142857142857142857142857142857");
+    CHECK((power(10, 36) % 7).toString() == "1");
+    CHECK((BigInteger(-17) / BigInteger(5)).toString() == "-3");
+    CHECK((BigInteger(-17) % BigInteger(5)).toString() == "-2");
+    for (size_t n : {30, 300, 3000}) {
+        const BigInteger divisor = parse(randomDigits(n / 2 + 1));
+        const BigInteger quotient = parse(randomDigits(n));
+        const BigInteger remainder = parse(randomDigits(n / 2 + 1)) % divisor;
+        const BigInteger dividend = quotient * divisor + remainder;
+        CHECK(dividend / divisor == quotient);
+        CHECK(dividend % divisor == remainder);
+        const auto [q, r] = divmod(dividend, divisor);
+        CHECK(q == quotient && r == remainder);
+    }
+}
+
+void testGcd() {
+    CHECK(GCD(BigInteger(48), BigInteger(-180)).toString() == "12");
+    CHECK(GCD(BigInteger(0), BigInteger(9)).toString() == "9");
+    for (size_t n : {20, 400, 2000}) {
+        const BigInteger common = parse(randomDigits(n));
+        BigInteger a = parse(randomDigits(n));
+        BigInteger b = parse(randomDigits(n + 7));
+        const BigInteger g = GCD(a, b);
+        a /= g;
+        b /= g;
+        CHECK(GCD(a * common, b * common) == common);
+    }
+}
+
+void testInlineStorage() {
+    static_assert(std::is_nothrow_move_constructible_v<BigInteger>);
+    // Values grow past the inline limbs and shrink back into them.
+    std::vector<BigInteger> powers;
+    BigInteger value = 1;
+    for (int i = 0; i < 60; ++i) {
+        powers.push_back(value);
+        value *= BigInteger(1000);
+    }
+    bool same = true;
+    for (int i = 59; i >= 0; --i) {
+        value /= BigInteger(1000);
+        same = same && value == powers[i] && value.toString() == "1" + std::string(3 * i, '0');
+    }
+    CHECK(same);
+    BigInteger moved = std::move(powers[40]);
+    CHECK(moved.toString() == "1" + std::string(120, '0'));
+    BigInteger target = powers[1];
+    target = moved;
+    CHECK(target == moved);
+    target = powers[2];
+    CHECK(target.toString() == "1000000");
+    target = std::move(moved);
+    CHECK(target.toString() == "1" + std::string(120, '0'));
+    std::vector<BigInteger> relocated;
+    for (const BigInteger &power : powers) {
+        relocated.push_back(power);
+    }
+    CHECK(relocated == powers);
+}
+
+// Limbs of one pattern: 0 all ones, 1 zeros, 2 random, 3 random with runs of
+// all-ones limbs, 4 a single one.
+std::vector<Limb> limbPattern(int kind, size_t length) {
+    std::vector<Limb> limbs(length, 0);
+    for (size_t i = 0; i < length; ++i) {
+        const Limb random = Limb(rng());
+        limbs[i] = kind == 0 ? LIMB_MAX : kind == 2 ? random : kind == 3 ? (i % 11 < 8 ? LIMB_MAX : random) : 0;
+    }
+    if (kind == 4 && length > 0) {
+        limbs[0] = 1;
+    }
+    return limbs;
+}
+
+// addCarry, subtractBorrow and compareLimbs with and without the vector
+// kernels against plain 64-bit carry loops, on carry chains through whole
+// blocks of all-ones or zero limbs.
+void testLimbKernels() {
+    bool same = true;
+    for (size_t length : {1, 8, 31, 32, 33, 40, 64, 100, 257}) {
+        for (int first = 0; first < 5; ++first) {
+            for (int second = 0; second < 5; ++second) {
+                const std::vector<Limb> x = limbPattern(first, length);
+                const std::vector<Limb> y = limbPattern(second, length);
+                for (Limb carryIn : {0, 1}) {
+                    std::vector<Limb> sum(length, 0);
+                    std::vector<Limb> difference(length, 0);
+                    Limb carry = carryIn;
+                    Limb borrow = carryIn;
+                    for (size_t i = 0; i < length; ++i) {
+                        const uint64_t wide = uint64_t(x[i]) + y[i] + carry;
+                        sum[i] = Limb(wide);
+                        carry = Limb(wide >> 32);
+                        const uint64_t narrow = uint64_t(x[i]) - y[i] - borrow;
+                        difference[i] = Limb(narrow);
+                        borrow = Limb(narrow >> 63);
+                    }
+                    const int order = x == y ? 0 : std::lexicographical_compare(x.rbegin(), x.rend(), y.rbegin(), y.rend()) ? -1 : 1;
+                    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX512}) {
+                        setSimdLevel(level);
+                        std::vector<Limb> result(length, 0);
+                        same = same && addCarry(x.data(), y.data(), result.data(), length, carryIn) == carry && result == sum;
+                        same = same && subtractBorrow(x.data(), y.data(), result.data(), length, carryIn) == borrow &&
+                               result == difference;
+                        same = same && compareLimbs(x.data(), length, y.data(), length) == order;
+                    }
+                }
+            }
+        }
+    }
+    CHECK(same);
+    // The same chains through BigInteger: (2^(32k) - 1) + 1 = 2^(32k).
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX512}) {
+        setSimdLevel(level);
+        for (int limbs : {31, 32, 33, 64, 100}) {
+            const BigInteger top = power(2, 32 * limbs);
+            const BigInteger ones = top - 1;
+            CHECK(ones + 1 == top);
+            CHECK(top - ones == 1);
+            CHECK(ones < top && top > ones && !(top < top));
+            CHECK((ones + ones).toString() == (top * 2 - 2).toString());
+        }
+    }
+}
+
+void testDecimalConversion() {
+    for (size_t n : {1, 9, 10, 300, 5000, 40000}) {
+        const std::string digits = randomDigits(n);
+        CHECK(parse(digits).toString() == digits);
+        CHECK(parse("-" + digits).toString() == "-" + digits);
+        std::ostringstream out;
+        out << parse(digits);
+        CHECK(out.str() == digits);
+    }
+    CHECK(power(10, 5000).toString() == "1" + std::string(5000, '0'));
+}
+
+// A block freed while a scope is open comes back for the next request of its
+// size, also after an inner scope closed; beyond LIMB_POOL_LIMIT limbs blocks
+// are deleted instead of cached.
+void testLimbPool() {
+    {
+        LimbPoolScope outer;
+        Limb *block = LimbPool::allocate(64);
+        {
+            LimbPoolScope inner;
+            LimbPool::deallocate(block, 64);
+        }
+        Limb *larger = LimbPool::allocate(128);
+        CHECK(larger != block);
+        CHECK(LimbPool::allocate(64) == block);
+        LimbPool::deallocate(larger, 128);
+        LimbPool::deallocate(block, 64);
+
+        // Freed on a thread without a scope: deleted there.
+        Limb *foreign = LimbPool::allocate(256);
+        std::thread([foreign] {
+            LimbPool::deallocate(foreign, 256);
+        }).join();
+    }
+
+    {
+        // Two halves of the limit are cached, a third is deleted.
+        LimbPoolScope scope;
+        const size_t half = LIMB_POOL_LIMIT / 2;
+        Limb *first = LimbPool::allocate(half);
+        Limb *second = LimbPool::allocate(half);
+        Limb *third = LimbPool::allocate(half);
+        LimbPool::deallocate(first, half);
+        LimbPool::deallocate(second, half);
+        LimbPool::deallocate(third, half);
+        Limb *reused = LimbPool::allocate(half);
+        Limb *older = LimbPool::allocate(half);
+        CHECK(reused == second && older == first);
+        LimbPool::deallocate(reused, half);
+        LimbPool::deallocate(older, half);
+    }
+
+    // A worker caches blocks while a task runs and none between tasks.
+    {
+        ThreadPool pool(1);
+        std::atomic<size_t> during{0};
+        std::atomic<size_t> after{1};
+        std::atomic<int> done{0};
+        pool.submit([&] {
+            LimbPool::deallocate(LimbPool::allocate(64), 64);
+            during = LimbPool::cached();
+            ++done;
+        });
+        while (done < 1) {
+            std::this_thread::yield();
+        }
+        pool.submit([&] {
+            after = LimbPool::cached();
+            ++done;
+        });
+        while (done < 2) {
+            std::this_thread::yield();
+        }
+        CHECK(during == 64 && after == 0);
+    }
+
+    // Values built in a scope outlive it and are freed outside any scope.
+    BigInteger product;
+    {
+        LimbPoolScope scope;
+        BigInteger factor = power(3, 500);
+        for (int i = 0; i < 20; ++i) {
+            factor = factor * BigInteger(7) + BigInteger(i);
+        }
+        product = factor * factor;
+    }
+    const BigInteger check = product / power(3, 500);
+    CHECK(check * power(3, 500) + product % power(3, 500) == product);
+}
+
+int main() {
+    testLimbBoundaries();
+    testLongProducts();
+    testDivision();
+    testGcd();
+    testInlineStorage();
+    testLimbKernels();
+    testDecimalConversion();
+    testLimbPool();
+    return checkResult("test_biginteger");
+}
@@ -0,0 +1,90 @@
+#include <random>
+#include <vector>
+#include "dynamicmatrix.h"
+#include "check.h"
+
+// DynamicMatrix against Matrix: both run the same algorithms, so every
+// operation must give the same entries.
+
+using R = Residue<1000000007>;
+
+std::mt19937 rng(6);
+
+template<size_t N, size_t M, typename Field>
+Matrix<N, M, Field> randomMatrix() {
+    Matrix<N, M, Field> result;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < M; ++j) {
+            if constexpr (std::is_same_v<Field, Rational>) {
+                result[i][j] = Rational(BigInteger(int(rng() % 201) - 100), BigInteger(int(rng() % 7) + 1));
+            } else {
+                result[i][j] = Field(int(rng() % 1000000007));
+            }
+        }
+    }
+    return result;
+}
+
+template<typename Field>
+using Dynamic = DynamicMatrix<Field>;
+
+template<size_t N, size_t M, size_t L, typename Field>
+void checkSameAsMatrix() {
+    const auto a = randomMatrix<N, M, Field>();
+    const auto b = randomMatrix<M, L, Field>();
+    const auto c = randomMatrix<N, N, Field>();
+    const Dynamic<Field> da(a);
+    const Dynamic<Field> db(b);
+    const Dynamic<Field> dc(c);
+    CHECK(da.rows() == N && da.columns() == M);
+    CHECK(da * db == Dynamic<Field>(a * b));
+    CHECK(da.transposed() == Dynamic<Field>(a.transposed()));
+    CHECK(da.rank() == a.rank());
+    CHECK(da.gauss() == Dynamic<Field>(a.gauss()));
+    CHECK(da.toDouble() == a.toDouble());
+    CHECK(dc.det() == c.det());
+    CHECK(dc.trace() == c.trace());
+    CHECK(dc.inverted() == Dynamic<Field>(c.inverted()));
+    CHECK(da.getRow(N - 1) == a.getRow(N - 1));
+    CHECK(std::vector<Field>(da.getColumn(M - 1)) == std::vector<Field>(a.getColumn(M - 1)));
+
+    Dynamic<Field> sum = dc;
+    Matrix<N, N, Field> expected = c;
+    sum += dc;
+    expected += c;
+    sum -= Dynamic<Field>(c.inverted());
+    expected -= c.inverted();
+    sum *= Field(3);
+    expected *= Field(3);
+    sum *= dc;
+    expected *= c;
+    CHECK(sum == Dynamic<Field>(expected));
+}
+
+void testConstructors() {
+    const Dynamic<R> identity(3, 3);
+    CHECK(identity == Dynamic<R>(SquareMatrix<3, R>()));
+    const Dynamic<R> zeros(2, 3);
+    CHECK(zeros.rank() == 0 && zeros.rows() == 2 && zeros.columns() == 3);
+    const Dynamic<R> listed = {{1, 2, 3}, {4, 5, 6}};
+    const Dynamic<R> rows(std::vector<std::vector<R>>{{R(1), R(2), R(3)}, {R(4), R(5), R(6)}});
+    CHECK(listed == rows);
+    CHECK(listed == Dynamic<R>(Matrix<2, 3, R>{{1, 2, 3}, {4, 5, 6}}));
+    CHECK(listed != zeros);
+    Dynamic<R> edited = listed;
+    edited[1][2] = R(9);
+    edited.column(0)[0] = R(7);
+    CHECK(edited == Dynamic<R>({{7, 2, 3}, {4, 5, 9}}));
+}
+
+int main() {
+    testConstructors();
+    checkSameAsMatrix<5, 7, 4, Rational>();
+    checkSameAsMatrix<10, 3, 9, Rational>();
+    checkSameAsMatrix<6, 9, 2, R>();
+    checkSameAsMatrix<70, 50, 60, R>();
+    setMatrixThreads(4);
+    checkSameAsMatrix<70, 50, 60, R>();
+    setMatrixThreads(1);
+    return checkResult("test_dynamicmatrix");
+}
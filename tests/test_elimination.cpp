@@ -0,0 +1,145 @@
+#include <random>
+#include <vector>
+#include "matrix.h"
+#include "check.h"
+
+// det(), rank(), inverted() and gauss() over Rational (Bareiss and
+// multi-modular) and Residue, serial and threaded. Determinants are compared
+// with a plain fraction elimination, ranks are those of constructed products
+// and inverses are multiplied back, also above the Strassen threshold and
+// with zero pivots.
+
+using R = Residue<1000000007>;
+
+std::mt19937 rng(4);
+
+template<typename Field>
+Field randomEntry(int bound) {
+    if constexpr (std::is_same_v<Field, Rational>) {
+        return Rational(BigInteger(int(rng() % (2 * bound + 1)) - bound), BigInteger(int(rng() % 9) + 1));
+    } else {
+        return Field(int(rng() % 1000000007));
+    }
+}
+
+template<size_t N, size_t M, typename Field>
+Matrix<N, M, Field> randomMatrix(int bound = 50) {
+    Matrix<N, M, Field> result;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < M; ++j) {
+            result[i][j] = randomEntry<Field>(bound);
+        }
+    }
+    return result;
+}
+
+template<size_t N, typename Field>
+Field naiveDet(const Matrix<N, N, Field> &matrix) {
+    std::vector<std::vector<Field>> a(N, std::vector<Field>(N, Field(0)));
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            a[i][j] = matrix[i][j];
+        }
+    }
+    Field det(1);
+    for (size_t k = 0; k < N; ++k) {
+        size_t pivot = k;
+        while (pivot < N && a[pivot][k] == Field(0)) {
+            ++pivot;
+        }
+        if (pivot == N) {
+            return Field(0);
+        }
+        if (pivot != k) {
+            std::swap(a[pivot], a[k]);
+            det = Field(0) - det;
+        }
+        det *= a[k][k];
+        for (size_t i = k + 1; i < N; ++i) {
+            const Field factor = a[i][k] / a[k][k];
+            for (size_t j = k; j < N; ++j) {
+                a[i][j] -= factor * a[k][j];
+            }
+        }
+    }
+    return det;
+}
+
+template<size_t N, typename Field>
+void checkSquare() {
+    const auto a = randomMatrix<N, N, Field>();
+    CHECK(a.det() == naiveDet(a));
+    CHECK(a.rank() == N);
+    CHECK((a * a.inverted() == SquareMatrix<N, Field>()));
+    CHECK(a.inverted().inverted() == a);
+    auto inverse = a;
+    inverse.invert();
+    CHECK(inverse == a.inverted());
+    // Rank r < N: an N x r times an r x N matrix.
+    const size_t r = N / 2;
+    const auto low = randomMatrix<N, N / 2, Field>() * randomMatrix<N / 2, N, Field>();
+    CHECK(low.rank() == r);
+    CHECK(low.det() == Field(0));
+    CHECK(naiveDet(low) == Field(0));
+    std::vector<Field> values(N * N, Field(0));
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            values[i * N + j] = low[i][j];
+        }
+    }
+    CHECK(!invertMatrix(values.data(), N));
+    // gauss() leaves zeros below the diagonal of a non-singular matrix.
+    const auto echelon = a.gauss();
+    bool zeros = true;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            zeros = zeros && echelon[i][j] == Field(0);
+        }
+    }
+    CHECK(zeros);
+}
+
+// Zero pivots force row swaps in the in-place inversion.
+template<typename Field>
+void checkZeroPivots() {
+    const Matrix<3, 3, Field> a = {{0, 1, 2}, {1, 0, 3}, {4, -3, 8}};
+    CHECK((a * a.inverted() == SquareMatrix<3, Field>()));
+    CHECK((a.inverted() * a == SquareMatrix<3, Field>()));
+    const Matrix<3, 3, Field> b = {{0, 0, 1}, {0, 1, 0}, {1, 0, 0}};
+    CHECK(b.inverted() == b);
+}
+
+void testLargeRationalEntries() {
+    // Entries far beyond the word-sized form take the integer product path.
+    auto a = randomMatrix<10, 10, Rational>(1000);
+    for (size_t i = 0; i < 10; ++i) {
+        a[i][i] = a[i][i] * Rational(BigInteger(1000000007) * BigInteger(1000000009)) + Rational(1);
+    }
+    CHECK(a.det() == naiveDet(a));
+    CHECK((a * a.inverted() == SquareMatrix<10, Rational>()));
+    CHECK(multiModularDet(&a[0][0], 10) == a.det());
+    CHECK(multiModularDet(&a[0][0], 10, true) == a.det());
+    const auto low = randomMatrix<9, 4, Rational>(1000) * randomMatrix<4, 7, Rational>(1000);
+    CHECK(multiModularRank(&low[0][0], 9, 7) == 4);
+}
+
+int main() {
+    for (size_t threads : {1, 4}) {
+        setMatrixThreads(threads);
+        checkSquare<1, Rational>();
+        checkSquare<5, Rational>();
+        checkSquare<8, Rational>();
+        checkSquare<12, Rational>();
+        checkSquare<6, R>();
+        checkSquare<60, R>();
+        setStrassenThreshold(8);
+        checkSquare<24, Rational>();
+        checkSquare<150, R>();
+        setStrassenThreshold(128);
+        testLargeRationalEntries();
+        checkZeroPivots<Rational>();
+        checkZeroPivots<R>();
+    }
+    setMatrixThreads(1);
+    return checkResult("test_elimination");
+}
@@ -0,0 +1,157 @@
+#include <random>
+#include <sstream>
+#include <vector>
+#include "dynamicmatrix.h"
+#include "check.h"
+
+// Elementwise expressions against entry-by-entry loops, including a
+// destination that appears in its own expression at any position, scaled
+// operands of products, the matrix operations and output on expressions, and
+// expressions and rows of them that hold temporaries.
+
+using R = Residue<1000000007>;
+
+std::mt19937 rng(7);
+
+template<typename Field>
+Field randomEntry() {
+    if constexpr (std::is_same_v<Field, Rational>) {
+        return Rational(BigInteger(int(rng() % 201) - 100), BigInteger(int(rng() % 7) + 1));
+    } else {
+        return Field(int(rng() % 1000000007));
+    }
+}
+
+template<size_t N, size_t M, typename Field>
+Matrix<N, M, Field> randomMatrix() {
+    Matrix<N, M, Field> result;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < M; ++j) {
+            result[i][j] = randomEntry<Field>();
+        }
+    }
+    return result;
+}
+
+// first * x + second * y, entry by entry.
+template<typename MatrixType, typename Field>
+MatrixType combination(const Field &first, const MatrixType &x, const Field &second, const MatrixType &y) {
+    MatrixType result = x;
+    for (size_t i = 0; i < MatrixTraits<MatrixType>::rows(x); ++i) {
+        for (size_t j = 0; j < MatrixTraits<MatrixType>::columns(x); ++j) {
+            result[i][j] = first * x[i][j] + second * y[i][j];
+        }
+    }
+    return result;
+}
+
+template<typename MatrixType, typename Field>
+void checkAliasing(const MatrixType &a, const MatrixType &b) {
+    const Field one(1);
+    const Field zero(0);
+    const Field minusOne = zero - one;
+    const Field c = randomEntry<Field>();
+    MatrixType x = a;
+    x = b - x;
+    CHECK(x == combination(one, b, minusOne, a));
+    x = a;
+    x = c * b + x;
+    CHECK(x == combination(c, b, one, a));
+    x = a;
+    x += b + x;
+    CHECK(x == combination(Field(2), a, one, b));
+    x = a;
+    x -= x + b;
+    CHECK(x == combination(zero, a, minusOne, b));
+    x = a;
+    x = x + c * x;
+    CHECK(x == combination(one + c, a, zero, b));
+    x = a;
+    x = c * (b - x) + x;
+    CHECK(x == combination(one - c, a, c, b));
+    x = a;
+    x = x - b;
+    CHECK(x == combination(one, a, minusOne, b));
+}
+
+template<typename MatrixType>
+std::string printed(const MatrixType &matrix) {
+    std::ostringstream out;
+    out << matrix;
+    return out.str();
+}
+
+template<typename MatrixType, typename Field>
+void checkOperations(const MatrixType &a, const MatrixType &b) {
+    const MatrixType sum = combination(Field(1), a, Field(1), b);
+    const MatrixType difference = combination(Field(1), a, Field(0) - Field(1), b);
+    CHECK((a + b).det() == sum.det());
+    CHECK((a - b).rank() == difference.rank());
+    CHECK((a + b).trace() == sum.trace());
+    CHECK((a - b).transposed() == difference.transposed());
+    CHECK((a + b).inverted() == sum.inverted());
+    CHECK((a - b).gauss() == difference.gauss());
+    CHECK((a + b).toDouble() == sum.toDouble());
+    if constexpr (!std::is_same_v<Field, Rational>) {
+        CHECK(printed(a + b) == printed(sum));
+    }
+
+    // Products are temporaries moved into the expression, named matrices are
+    // referred to; either way the expression may be kept in a variable.
+    const MatrixType product = a * b;
+    const auto kept = a * b + Field(2) * (b * a) - a;
+    const auto named = a + b;
+    CHECK(kept == combination(Field(1), product, Field(2), MatrixType(b * a)) - a);
+    CHECK(named == sum);
+    const auto scaled = Field(3) * (Field(2) * (a * b));
+    CHECK(scaled == combination(Field(6), product, Field(0), b));
+
+    // A row of a temporary expression keeps the expression alive.
+    const auto row = (a * b + a)[1];
+    const auto namedRow = named[1];
+    bool same = true;
+    for (size_t j = 0; j < MatrixTraits<MatrixType>::columns(a); ++j) {
+        same = same && row[j] == product[1][j] + a[1][j] && namedRow[j] == sum[1][j] && (a - b)[1][j] == difference[1][j];
+    }
+    CHECK(same);
+}
+
+template<size_t N, size_t M, typename Field>
+void checkExpressions() {
+    const auto a = randomMatrix<N, M, Field>();
+    const auto b = randomMatrix<N, M, Field>();
+    const Field c = randomEntry<Field>();
+    Matrix<N, M, Field> result = a + b - c * a;
+    CHECK(result == combination(Field(1) - c, a, Field(1), b));
+    result = (a - b) * c;
+    CHECK(result == combination(c, a, Field(0) - c, b));
+    // The destination as the left-most operand.
+    result = a;
+    result = result - c * b;
+    CHECK(result == combination(Field(1), a, Field(0) - c, b));
+    result += a;
+    CHECK(result == combination(Field(2), a, Field(0) - c, b));
+    DynamicMatrix<Field> dynamic(a);
+    dynamic = dynamic + DynamicMatrix<Field>(b) * c;
+    CHECK(dynamic == DynamicMatrix<Field>(combination(Field(1), a, c, b)));
+    checkAliasing<Matrix<N, M, Field>, Field>(a, b);
+    checkAliasing<DynamicMatrix<Field>, Field>(DynamicMatrix<Field>(a), DynamicMatrix<Field>(b));
+    // A scaled operand of a product goes into the kernel as a multiplier.
+    const auto square = randomMatrix<M, M, Field>();
+    CHECK((a * (c * square) == c * Matrix<N, M, Field>(a * square)));
+    CHECK(((c * a) * (square * c) == Matrix<N, M, Field>(a * square) * (c * c)));
+    const auto other = randomMatrix<M, M, Field>();
+    checkOperations<Matrix<M, M, Field>, Field>(square, other);
+    checkOperations<DynamicMatrix<Field>, Field>(DynamicMatrix<Field>(square), DynamicMatrix<Field>(other));
+}
+
+int main() {
+    for (size_t threads : {1, 4}) {
+        setMatrixThreads(threads);
+        checkExpressions<3, 4, R>();
+        checkExpressions<70, 50, R>();
+        checkExpressions<5, 6, Rational>();
+    }
+    setMatrixThreads(1);
+    return checkResult("test_expression");
+}
@@ -0,0 +1,157 @@
+#include <random>
+#include <vector>
+#include "matrix.h"
+#include "check.h"
+
+// Storage, views and products of Matrix. Products are compared with a plain
+// triple loop, for Rational also with multi-limb entries, including shapes
+// that end in partial tiles of the blocked kernel, below and above the
+// Strassen threshold, serial and threaded. Threaded elimination must match
+// the serial one.
+
+using R = Residue<1000000007>;
+
+std::mt19937 rng(1);
+
+template<size_t N, size_t M>
+Matrix<N, M, R> randomResidues() {
+    Matrix<N, M, R> result;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < M; ++j) {
+            result[i][j] = R(int(rng() % 1000000007));
+        }
+    }
+    return result;
+}
+
+template<size_t N, size_t M>
+Matrix<N, M, Rational> randomRationals(int numerators, int denominators) {
+    Matrix<N, M, Rational> result;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < M; ++j) {
+            BigInteger numerator(int(rng() % (2 * numerators + 1)) - numerators);
+            result[i][j] = Rational(numerator) / Rational(BigInteger(int(rng() % denominators) + 1));
+        }
+    }
+    return result;
+}
+
+// Entries of several limbs: scale times a small fraction.
+template<size_t N, size_t M>
+Matrix<N, M, Rational> largeRationals(const BigInteger &scale) {
+    Matrix<N, M, Rational> result = randomRationals<N, M>(1000, 30);
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < M; ++j) {
+            result[i][j] = result[i][j] * Rational(scale) + Rational(BigInteger(int(i + j)));
+        }
+    }
+    return result;
+}
+
+template<size_t N, size_t M, size_t L, typename Field>
+Matrix<N, L, Field> naiveProduct(const Matrix<N, M, Field> &a, const Matrix<M, L, Field> &b) {
+    Matrix<N, L, Field> result;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < L; ++j) {
+            Field sum(0);
+            for (size_t k = 0; k < M; ++k) {
+                sum += a[i][k] * b[k][j];
+            }
+            result[i][j] = sum;
+        }
+    }
+    return result;
+}
+
+// Products with multi-limb entries run on integers over common denominators.
+template<size_t N, size_t M, size_t L>
+void checkLargeRationalProducts() {
+    BigInteger scale(1000000007);
+    scale *= scale;
+    scale *= scale;
+    const auto a = largeRationals<N, M>(scale);
+    const auto b = largeRationals<M, L>(scale + BigInteger(1));
+    CHECK(a * b == naiveProduct(a, b));
+}
+
+void testStorageAndViews() {
+    Matrix<2, 3, R> a = {{1, 2, 3}, {4, 5, 6}};
+    CHECK(a[1][2] == R(6));
+    a[0][1] = R(7);
+    CHECK(a.getRow(0)[1] == R(7));
+    std::vector<R> column = a.getColumn(2);
+    CHECK(column.size() == 2 && column[0] == R(3) && column[1] == R(6));
+    a.column(0)[1] = R(9);
+    CHECK(a[1][0] == R(9));
+    std::vector<R> row = a[1];
+    CHECK(row == std::vector<R>({R(9), R(5), R(6)}));
+    CHECK(a.transposed()[2][1] == R(6));
+    SquareMatrix<3, R> identity;
+    CHECK(identity[1][1] == R(1) && identity[1][2] == R(0));
+    CHECK(identity.trace() == R(3));
+    // Same entries in the same order, different shapes.
+    const Matrix<2, 3, R> wide = {{1, 2, 3}, {4, 5, 6}};
+    const Matrix<3, 2, R> tall = {{1, 2}, {3, 4}, {5, 6}};
+    CHECK(wide != tall && !(tall == wide));
+    CHECK(wide.transposed() != tall);
+}
+
+void testToDouble() {
+    Matrix<2, 2, Rational> a;
+    a[0][0] = Rational(1) / Rational(3);
+    a[0][1] = Rational(-5);
+    a[1][0] = Rational(7) / Rational(2);
+    CHECK(a.toDouble() == std::vector<double>({1.0 / 3.0, -5.0, 3.5, 1.0}));
+}
+
+template<size_t N, size_t M, size_t L>
+void checkProducts() {
+    const auto a = randomResidues<N, M>();
+    const auto b = randomResidues<M, L>();
+    CHECK(a * b == naiveProduct(a, b));
+    const auto c = randomRationals<N, M>(1000, 30);
+    const auto d = randomRationals<M, L>(1000, 30);
+    CHECK(c * d == naiveProduct(c, d));
+}
+
+// Threaded elimination runs the same operations on every row as the serial one.
+void checkThreadedElimination() {
+    using S = Residue<10007>;
+    SquareMatrix<60, S> a;
+    for (size_t i = 0; i < 60; ++i) {
+        for (size_t j = 0; j < 60; ++j) {
+            a[i][j] = S(int(rng() % 10007));
+        }
+    }
+    setMatrixThreads(1);
+    const S det = a.det();
+    const size_t rank = a.rank();
+    const auto inverse = a.inverted();
+    setMatrixThreads(4);
+    CHECK(a.det() == det);
+    CHECK(a.rank() == rank);
+    CHECK(a.inverted() == inverse);
+    setMatrixThreads(1);
+}
+
+int main() {
+    testStorageAndViews();
+    testToDouble();
+    for (size_t threads : {1, 4}) {
+        setMatrixThreads(threads);
+        checkProducts<5, 7, 3>();
+        checkProducts<17, 33, 9>();
+        checkLargeRationalProducts<5, 6, 4>();
+        setStrassenThreshold(8);
+        checkProducts<33, 35, 37>();
+        checkProducts<40, 40, 40>();
+        checkLargeRationalProducts<17, 18, 19>();
+        setStrassenThreshold(128);
+        const auto a = randomResidues<130, 131>();
+        const auto b = randomResidues<131, 129>();
+        CHECK(a * b == naiveProduct(a, b));
+    }
+    setMatrixThreads(1);
+    checkThreadedElimination();
+    return checkResult("test_matrix");
+}
@@ -0,0 +1,103 @@
+#include <random>
+#include <thread>
+#include <vector>
+#include "plu.h"
+#include "check.h"
+
+// PLU factorization: P * A = L * U, det() and rank() as on the matrix, solve()
+// for vectors and blocks of right-hand sides, and the Rational inverse that is
+// computed on first use, also from several threads and from a copy.
+
+using R = Residue<998244353>;
+
+std::mt19937 rng(5);
+
+template<typename Field>
+Field randomEntry() {
+    if constexpr (std::is_same_v<Field, Rational>) {
+        return Rational(BigInteger(int(rng() % 41) - 20), BigInteger(int(rng() % 5) + 1));
+    } else {
+        return Field(int(rng() % 998244353));
+    }
+}
+
+template<size_t N, size_t M, typename Field>
+Matrix<N, M, Field> randomMatrix() {
+    Matrix<N, M, Field> result;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < M; ++j) {
+            result[i][j] = randomEntry<Field>();
+        }
+    }
+    return result;
+}
+
+template<size_t N, typename Field>
+void checkFactors(const Matrix<N, N, Field> &a, const PLU<N, Field> &plu) {
+    Matrix<N, N, Field> permuted;
+    for (size_t i = 0; i < N; ++i) {
+        permuted[i] = a[plu.permutation()[i]];
+    }
+    CHECK((plu.lower() * plu.upper() == permuted));
+    CHECK(plu.det() == a.det());
+    CHECK(plu.rank() == a.rank());
+}
+
+template<size_t N, typename Field>
+void checkPlu() {
+    const auto a = randomMatrix<N, N, Field>();
+    const PLU<N, Field> plu(a);
+    checkFactors(a, plu);
+    std::vector<Field> b(N, Field(0));
+    for (size_t i = 0; i < N; ++i) {
+        b[i] = randomEntry<Field>();
+    }
+    const std::vector<Field> x = plu.solve(b);
+    bool solved = true;
+    for (size_t i = 0; i < N; ++i) {
+        solved = solved && dotProduct(&a[i][0], x.data(), N) == b[i];
+    }
+    CHECK(solved);
+    const auto block = randomMatrix<N, 3, Field>();
+    CHECK((a * plu.solve(block) == block));
+    CHECK(plu.inverse() == a.inverted());
+
+    // The first inverse() may come from several threads at once, or from a copy.
+    const PLU<N, Field> shared(a);
+    const PLU<N, Field> copy = shared;
+    std::vector<Matrix<N, N, Field>> inverses(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < inverses.size(); ++t) {
+        threads.emplace_back([&, t] {
+            inverses[t] = (t % 2 == 0 ? shared : copy).inverse();
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (const auto &inverse : inverses) {
+        CHECK(inverse == inverses[0]);
+    }
+    CHECK(inverses[0] == a.inverted());
+
+    // A singular matrix: rank and det come from the factorization all the same.
+    auto singular = a;
+    singular[N - 1] = std::vector<Field>(N, Field(0));
+    if (N > 1) {
+        singular[0] = a[1];
+    }
+    checkFactors(singular, PLU<N, Field>(singular));
+}
+
+int main() {
+    checkPlu<1, Rational>();
+    checkPlu<6, Rational>();
+    checkPlu<12, Rational>();
+    checkPlu<1, R>();
+    checkPlu<40, R>();
+    setMatrixThreads(4);
+    checkPlu<12, Rational>();
+    checkPlu<100, R>();
+    setMatrixThreads(1);
+    return checkResult("test_plu");
+}
@@ -0,0 +1,169 @@
+#include <random>
+#include <vector>
+#include "dynamicmatrix.h"
+#include "check.h"
+
+// pow() by every method against repeated multiplication, for long long,
+// BigInteger and negative exponents and for a composite modulus, and
+// recurrenceTerm() against the terms computed one by one and against a power
+// of the companion matrix.
+
+using R = Residue<1000000007>;
+
+std::mt19937 rng(8);
+
+// Entries below 7, a share of them zero, so sparse and singular matrices
+// come up too.
+template<size_t N, typename Field>
+SquareMatrix<N, Field> randomMatrix(int zeros) {
+    SquareMatrix<N, Field> result;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            result[i][j] = int(rng() % 100) < zeros ? Field(0) : Field(int(rng() % 7));
+        }
+    }
+    return result;
+}
+
+template<size_t N, typename Field>
+SquareMatrix<N, Field> repeatedProduct(const SquareMatrix<N, Field> &matrix, long long exponent) {
+    SquareMatrix<N, Field> result;
+    for (long long i = 0; i < exponent; ++i) {
+        result *= matrix;
+    }
+    return result;
+}
+
+// (10^9 + 7)^4 + 12345, beyond a long long.
+BigInteger bigExponent() {
+    BigInteger result(1000000007);
+    result *= result;
+    result *= result;
+    return result + BigInteger(12345);
+}
+
+template<size_t N>
+void checkResiduePower() {
+    for (int zeros : {0, 50, 90, 100}) {
+        const auto a = randomMatrix<N, R>(zeros);
+        for (long long exponent : {0, 1, 2, 3, 7, 16, 37}) {
+            const auto expected = repeatedProduct(a, exponent);
+            CHECK(pow(a, exponent, PowerMethod::Binary) == expected);
+            CHECK(pow(a, exponent, PowerMethod::CharacteristicPolynomial) == expected);
+            CHECK(pow(a, exponent) == expected);
+        }
+        CHECK(pow(a, 123456789012345LL, PowerMethod::Binary) ==
+              pow(a, 123456789012345LL, PowerMethod::CharacteristicPolynomial));
+
+        // The exponent outlives the BigInteger it was made from.
+        const PowerExponent big = bigExponent();
+        const auto binary = pow(a, big, PowerMethod::Binary);
+        CHECK(pow(a, big, PowerMethod::CharacteristicPolynomial) == binary);
+        CHECK(pow(a, bigExponent() + BigInteger(1)) == binary * a);
+        CHECK(pow(DynamicMatrix<R>(a), big) == DynamicMatrix<R>(binary));
+
+        if (a.det() != R(0)) {
+            const auto inverse = a.inverted();
+            CHECK(pow(a, -5, PowerMethod::Binary) == repeatedProduct(inverse, 5));
+            CHECK(pow(a, -5, PowerMethod::CharacteristicPolynomial) == repeatedProduct(inverse, 5));
+            CHECK(pow(a, -bigExponent()) == pow(inverse, big));
+        }
+    }
+}
+
+void checkRationalPower() {
+    const auto a = randomMatrix<4, Rational>(30);
+    for (long long exponent : {0, 1, 5, 12}) {
+        const auto expected = repeatedProduct(a, exponent);
+        CHECK(pow(a, exponent) == expected);
+        CHECK(pow(a, exponent, PowerMethod::CharacteristicPolynomial) == expected);
+    }
+    if (a.det() != Rational(0)) {
+        CHECK(pow(a, -3) == repeatedProduct(a.inverted(), 3));
+    }
+}
+
+// Residues modulo 6 have zero divisors, so only Binary applies.
+void checkCompositePower() {
+    using Z = Residue<6>;
+    const auto a = randomMatrix<3, Z>(20);
+    for (long long exponent : {0, 1, 5, 13}) {
+        const auto expected = repeatedProduct(a, exponent);
+        CHECK(pow(a, exponent) == expected);
+        CHECK(pow(a, exponent, PowerMethod::Binary) == expected);
+        CHECK(pow(DynamicMatrix<Z>(a), exponent) == DynamicMatrix<Z>(expected));
+    }
+    // A^(2k) = (A^2)^k.
+    CHECK(pow(a, bigExponent() * BigInteger(2)) == pow(a * a, bigExponent()));
+    const std::vector<Z> doubling = {Z(2)};
+    CHECK(recurrenceTerm(doubling, {Z(1)}, 10LL) == Z(1024 % 6));
+}
+
+void checkRecurrence() {
+    // Fibonacci numbers.
+    const std::vector<R> fibonacci = {R(1), R(1)};
+    std::vector<R> terms = {R(0), R(1)};
+    for (size_t k = 2; k < 300; ++k) {
+        terms.push_back(terms[k - 1] + terms[k - 2]);
+    }
+    bool same = true;
+    for (size_t k = 0; k < terms.size(); ++k) {
+        same = same && recurrenceTerm(fibonacci, {R(0), R(1)}, (long long)(k)) == terms[k];
+    }
+    CHECK(same);
+
+    // A random recurrence of order 6: a_k = sum of c_i * a_{k - 1 - i}.
+    const size_t order = 6;
+    std::vector<R> coefficients;
+    std::vector<R> initial;
+    for (size_t i = 0; i < order; ++i) {
+        coefficients.push_back(R(int(rng() % 1000000007)));
+        initial.push_back(R(int(rng() % 1000000007)));
+    }
+    terms = initial;
+    for (size_t k = order; k < 200; ++k) {
+        R term(0);
+        for (size_t i = 0; i < order; ++i) {
+            term += coefficients[i] * terms[k - 1 - i];
+        }
+        terms.push_back(term);
+    }
+    same = true;
+    for (size_t k = 0; k < terms.size(); ++k) {
+        same = same && recurrenceTerm(coefficients, initial, (long long)(k)) == terms[k];
+    }
+    CHECK(same);
+
+    // The companion matrix maps (a_{k+5}, ..., a_k) to (a_{k+6}, ..., a_{k+1}).
+    SquareMatrix<order, R> companion;
+    for (size_t i = 0; i < order; ++i) {
+        companion[i][i] = R(0);
+        companion[0][i] = coefficients[i];
+        if (i > 0) {
+            companion[i][i - 1] = R(1);
+        }
+    }
+    const auto power = pow(companion, bigExponent(), PowerMethod::Binary);
+    R term(0);
+    for (size_t j = 0; j < order; ++j) {
+        term += power[order - 1][j] * initial[order - 1 - j];
+    }
+    CHECK(recurrenceTerm(coefficients, initial, bigExponent()) == term);
+}
+
+int main() {
+    for (size_t threads : {1, 4}) {
+        setMatrixThreads(threads);
+        checkResiduePower<1>();
+        checkResiduePower<3>();
+        checkResiduePower<17>();
+        setStrassenThreshold(8);
+        checkResiduePower<40>();
+        setStrassenThreshold(128);
+        checkRationalPower();
+        checkCompositePower();
+        checkRecurrence();
+    }
+    setMatrixThreads(1);
+    return checkResult("test_power");
+}
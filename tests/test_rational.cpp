@@ -0,0 +1,153 @@
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include "rational.h"
+#include "check.h"
+
+// Rational arithmetic across the word-sized and BigInteger forms, including
+// values near the int64 boundary, the deferred-normalization accumulator,
+// decimal output and the correctly rounded conversion to double.
+
+std::mt19937_64 rng(3);
+
+BigInteger power(const BigInteger &base, int exponent) {
+    BigInteger result = 1;
+    for (int i = 0; i < exponent; ++i) {
+        result *= base;
+    }
+    return result;
+}
+
+Rational fraction(const BigInteger &numerator, const BigInteger &denominator) {
+    return Rational(numerator, denominator);
+}
+
+void testArithmetic() {
+    CHECK(fraction(6, -4).toString() == "-3/2");
+    CHECK((Rational(1) / Rational(3) + fraction(1, 6)).toString() == "1/2");
+    CHECK((fraction(2, 3) * fraction(9, 4)).toString() == "3/2");
+    CHECK(fraction(5, 10) == fraction(1, 2));
+    CHECK(fraction(1, 3) < fraction(1, 2) && fraction(-1, 2) < fraction(-1, 3));
+    // Products beyond 64 bits are promoted to BigInteger and reduced back.
+    const BigInteger big = power(2, 40) + 1;
+    const Rational x = fraction(big, 3);
+    CHECK((x * x).toString() == (big * big).toString() + "/9");
+    CHECK(x * x / x == x);
+    CHECK((x * x - x * x).toString() == "0");
+    const Rational huge = fraction(power(10, 30) + 7, power(10, 29) + 3);
+    CHECK(huge - huge + Rational(5) == Rational(5));
+}
+
+void testAccumulator() {
+    std::vector<Rational> first;
+    std::vector<Rational> second;
+    for (int i = 0; i < 200; ++i) {
+        const int64_t numerator = int64_t(rng() % 2000001) - 1000000;
+        BigInteger scale = i % 50 == 0 ? power(10, 25) : BigInteger(1);
+        first.push_back(fraction(BigInteger(int(numerator)) * scale, int(rng() % 997) + 1));
+        second.push_back(fraction(int(rng() % 1000), int(rng() % 61) + 1));
+    }
+    RationalAccumulator sum;
+    Rational expected = 0;
+    for (size_t i = 0; i < first.size(); ++i) {
+        if (i % 3 == 0) {
+            sum.subtractProduct(first[i], second[i]);
+            expected -= first[i] * second[i];
+        } else {
+            sum.addProduct(first[i], second[i]);
+            expected += first[i] * second[i];
+        }
+        sum.add(second[i]);
+        expected += second[i];
+    }
+    CHECK(sum.value() == expected);
+
+    // Products near 2^126 with a common denominator, so the second and third
+    // overflow the word-sized sum and have to go to rest unchanged.
+    const BigInteger near = power(2, 63) - 9;
+    RationalAccumulator squares;
+    expected = 0;
+    for (int i = 0; i < 3; ++i) {
+        const Rational x = fraction(near - i, 1);
+        squares.addProduct(x, x);
+        expected += x * x;
+    }
+    CHECK(squares.value() == expected);
+    CHECK(expected.toString() == "255211775190703847044128633362539610414");
+    RationalAccumulator differences;
+    const Rational y = fraction(near, 5);
+    for (int i = 0; i < 3; ++i) {
+        differences.subtractProduct(y, y);
+    }
+    differences.add(fraction(1, 25));
+    CHECK(differences.value() == fraction(1, 25) - Rational(3) * y * y);
+}
+
+void testDecimal() {
+    CHECK(fraction(1, 3).asDecimal(5) == "0.33333");
+    CHECK(fraction(-7, 2).asDecimal(1) == "-3.5");
+    CHECK(fraction(-1, 8).asDecimal(2) == "-0.12");
+    CHECK(fraction(22, 7).asDecimal(0) == "3");
+    CHECK(fraction(power(10, 40) + 1, power(10, 20)).asDecimal(25) == "100000000000000000000.0000000000000000000100000");
+}
+
+// Sums and products of word-sized values near 2^62 and 2^63 against the same
+// fractions built from BigIntegers.
+void testWordBoundary() {
+    bool same = true;
+    for (int i = 0; i < 2000; ++i) {
+        BigInteger parts[4];
+        for (BigInteger &part : parts) {
+            const uint64_t word = (rng() >> (i % 3)) | 1;
+            part = BigInteger(int((word >> 32) & 0x7fffffff)) * BigInteger(65536) * BigInteger(65536) + BigInteger(int(word & 0x7fffffff));
+        }
+        if (i % 2 == 1) {
+            parts[0] = -parts[0];
+        }
+        const Rational x = fraction(parts[0], parts[1]);
+        const Rational y = fraction(parts[2], parts[3]);
+        same = same && x + y == fraction(parts[0] * parts[3] + parts[2] * parts[1], parts[1] * parts[3]);
+        same = same && x - y == fraction(parts[0] * parts[3] - parts[2] * parts[1], parts[1] * parts[3]);
+        same = same && x * y == fraction(parts[0] * parts[2], parts[1] * parts[3]);
+        same = same && x / y == fraction(parts[0] * parts[3], parts[1] * parts[2]);
+        same = same && (x * y) / y == x;
+    }
+    CHECK(same);
+    CHECK(Rational().toString() == "0");
+}
+
+void testToDouble() {
+    // Both operands are exact doubles, so IEEE division rounds correctly too.
+    for (int i = 0; i < 10000; ++i) {
+        const int p = int(rng() % 2000000001) - 1000000000;
+        const int q = int(rng() % 1000000000) + 1;
+        CHECK(double(fraction(p, q)) == double(p) / double(q));
+    }
+    const BigInteger twoTo53 = power(2, 53);
+    CHECK(double(Rational(twoTo53 + 1)) == 9007199254740992.0);
+    CHECK(double(Rational(twoTo53 + 3)) == 9007199254740996.0);
+    CHECK(double(-Rational(twoTo53 + 1)) == -9007199254740992.0);
+    CHECK(double(fraction(power(10, 400), power(10, 399))) == 10.0);
+    CHECK(double(fraction(1, 3)) == 1.0 / 3.0);
+    CHECK(double(Rational(power(10, 400))) == std::numeric_limits<double>::infinity());
+    CHECK(double(fraction(1, power(10, 400))) == 0.0);
+    const double smallest = std::numeric_limits<double>::denorm_min();
+    CHECK(double(fraction(1, power(2, 1074))) == smallest);
+    CHECK(double(fraction(1, power(2, 1075))) == 0.0);
+    CHECK(double(fraction(3, power(2, 1076))) == smallest);
+    CHECK(double(fraction(3, power(2, 1075))) == 2 * smallest);
+    // Expected values from Python's correctly rounded float(Fraction(...)).
+    CHECK(double(fraction(power(3, 40), power(7, 30))) == 0x1.21963ced39cbcp-21);
+    CHECK(double(fraction(power(10, 30) + 7, power(10, 29) + 3)) == 0x1.4000000000000p+3);
+    CHECK(double(fraction(power(2, 80) + 1, power(3, 50))) == 0x1.af194f6982498p+0);
+}
+
+int main() {
+    testArithmetic();
+    testWordBoundary();
+    testAccumulator();
+    testDecimal();
+    testToDouble();
+    return checkResult("test_rational");
+}
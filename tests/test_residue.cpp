@@ -0,0 +1,198 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "matrix.h"
+#include "check.h"
+
+// Residue arithmetic with Barrett reduction against plain 64-bit remainders,
+// for small moduli and moduli up to 2^31 - 1, the lazily reduced dot
+// product against one reduction per term, the AVX2 and AVX-512 array
+// kernels against the scalar ones, and inverse() and batchInverse() against
+// Fermat's little theorem.
+
+std::mt19937_64 rng(9);
+
+template<size_t N>
+void checkArithmetic() {
+    using R = Residue<N>;
+    const int64_t modulus = int64_t(N);
+    for (int i = 0; i < 2000; ++i) {
+        const int x = int(rng() % 2147483648ULL) - (i % 2 == 0 ? 0 : 1073741824);
+        const int y = int(rng() % 2147483648ULL);
+        const int64_t a = ((x % modulus) + modulus) % modulus;
+        const int64_t b = y % modulus;
+        CHECK(int(R(x)) == a);
+        CHECK(int(R(x) + R(y)) == (a + b) % modulus);
+        CHECK(int(R(x) - R(y)) == (a - b + modulus) % modulus);
+        CHECK(int(R(x) * R(y)) == a * b % modulus);
+    }
+    CHECK(int(R(-1)) == int(modulus - 1));
+    CHECK(int(R(int(N - 1)) * R(int(N - 1))) == int(1 % modulus));
+}
+
+template<size_t N>
+void checkDotProduct() {
+    using R = Residue<N>;
+    for (size_t length : {0, 1, 7, 8, 17, 100, 1000}) {
+        std::vector<R> first;
+        std::vector<R> second;
+        uint64_t expected = 0;
+        for (size_t i = 0; i < length; ++i) {
+            // The largest residues in some runs, to fill the 64-bit sums.
+            const int x = length == 100 ? int(N - 1) : int(rng() % N);
+            const int y = length == 100 ? int(N - 1) : int(rng() % N);
+            first.push_back(R(x));
+            second.push_back(R(y));
+            expected = (expected + uint64_t(x) * uint64_t(y) % N) % N;
+        }
+        CHECK(uint64_t(int(dotProduct(first.data(), second.data(), length))) == expected);
+    }
+}
+
+template<size_t N>
+std::vector<Residue<N>> randomResidues(size_t length) {
+    std::vector<Residue<N>> result;
+    for (size_t i = 0; i < length; ++i) {
+        // Every fifth entry is N - 1, the largest residue.
+        result.push_back(Residue<N>(i % 5 == 4 ? int(N - 1) : int(rng() % N)));
+    }
+    return result;
+}
+
+// Every kernel at every level the processor supports gives the scalar result,
+// including the tails shorter than a vector.
+template<size_t N>
+void checkSimdLevels() {
+    using R = Residue<N>;
+    for (size_t length : {1, 7, 8, 15, 16, 17, 33, 100, 1001}) {
+        const auto x = randomResidues<N>(length);
+        const auto y = randomResidues<N>(length);
+        const R multiplier(int(N - 2));
+        std::vector<std::vector<R>> results;
+        std::vector<R> dots;
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            setSimdLevel(level);
+            std::vector<R> sum(length, R(0));
+            std::vector<R> difference(length, R(0));
+            std::vector<R> scaled(length, R(0));
+            std::vector<R> reduced = x;
+            addArrays(x.data(), y.data(), sum.data(), length);
+            subtractArrays(x.data(), y.data(), difference.data(), length);
+            scaleArray(x.data(), multiplier, scaled.data(), length);
+            subtractMultiple(reduced.data(), y.data(), multiplier, length);
+            results.push_back(sum);
+            results.push_back(difference);
+            results.push_back(scaled);
+            results.push_back(reduced);
+            dots.push_back(dotProduct(x.data(), y.data(), length));
+        }
+        setSimdLevel(SimdLevel::AVX512);
+        bool same = true;
+        for (size_t i = 0; i < length; ++i) {
+            same = same && results[0][i] == x[i] + y[i] && results[1][i] == x[i] - y[i];
+            same = same && results[2][i] == x[i] * multiplier && results[3][i] == x[i] - y[i] * multiplier;
+        }
+        CHECK(same);
+        for (size_t i = 4; i < results.size(); ++i) {
+            CHECK(results[i] == results[i % 4]);
+        }
+        for (const R &dot : dots) {
+            CHECK(dot == dots[0]);
+        }
+    }
+}
+
+// Products of Residue matrices go through the same kernels.
+void checkProductLevels() {
+    using R = Residue<1000000007>;
+    Matrix<37, 45, R> a;
+    Matrix<45, 29, R> b;
+    for (size_t i = 0; i < 45; ++i) {
+        for (size_t j = 0; j < 45; ++j) {
+            if (i < 37) {
+                a[i][j] = R(int(rng() % 1000000007));
+            }
+            if (j < 29) {
+                b[i][j] = R(int(rng() % 1000000007));
+            }
+        }
+    }
+    setSimdLevel(SimdLevel::Scalar);
+    const auto expected = a * b;
+    setSimdLevel(SimdLevel::AVX2);
+    CHECK(a * b == expected);
+    setSimdLevel(SimdLevel::AVX512);
+    CHECK(a * b == expected);
+}
+
+template<size_t N>
+Residue<N> power(Residue<N> base, uint64_t exponent) {
+    Residue<N> result(1);
+    for (; exponent > 0; exponent /= 2) {
+        if (exponent % 2 == 1) {
+            result *= base;
+        }
+        base *= base;
+    }
+    return result;
+}
+
+template<size_t N>
+void checkInverses() {
+    using R = Residue<N>;
+    for (int x : {1, int(N / 3) + 1, int(N - 1), int(N / 2)}) {
+        CHECK(R(x).inverse() == power(R(x), N - 2));
+        CHECK(R(x) * R(x).inverse() == R(1));
+    }
+    for (size_t count : {0, 1, 2, 3, 100}) {
+        std::vector<R> values;
+        for (size_t i = 0; i < count; ++i) {
+            values.push_back(R(int(rng() % (N - 1)) + 1));
+        }
+        std::vector<R> inverses = values;
+        R::batchInverse(inverses.data(), count);
+        bool inverted = true;
+        for (size_t i = 0; i < count; ++i) {
+            inverted = inverted && inverses[i] == values[i].inverse() && values[i] * inverses[i] == R(1);
+        }
+        CHECK(inverted);
+    }
+    const R x(int(rng() % (N - 1)) + 1);
+    const R y(int(rng() % (N - 1)) + 1);
+    CHECK(x / y * y == x);
+}
+
+// inverted() normalizes its pivot rows with one batch inversion.
+void checkMatrixInverse() {
+    using R = Residue<998244353>;
+    SquareMatrix<40, R> a;
+    for (size_t i = 0; i < 40; ++i) {
+        for (size_t j = 0; j < 40; ++j) {
+            a[i][j] = R(int(rng() % 998244353));
+        }
+    }
+    CHECK((a * a.inverted() == SquareMatrix<40, R>()));
+}
+
+int main() {
+    checkArithmetic<2>();
+    checkArithmetic<7>();
+    checkArithmetic<998244353>();
+    checkArithmetic<1000000007>();
+    checkArithmetic<2147483647>();
+    checkDotProduct<7>();
+    checkDotProduct<998244353>();
+    checkDotProduct<1000000007>();
+    checkDotProduct<2147483647>();
+    checkSimdLevels<7>();
+    checkSimdLevels<998244353>();
+    checkSimdLevels<1000000007>();
+    checkSimdLevels<2147483647>();
+    checkProductLevels();
+    checkInverses<2>();
+    checkInverses<7>();
+    checkInverses<998244353>();
+    checkInverses<2147483647>();
+    checkMatrixInverse();
+    return checkResult("test_residue");
+}
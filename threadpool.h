@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "limbbuffer.h"
+
+// Every worker owns a deque: it takes its own tasks from the back and steals
+// from the front of the other deques when its own one is empty.
+class ThreadPool {
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> nextQueue{0};
+    bool stopping = false;
+
+    static const ThreadPool *&currentPool() {
+        thread_local const ThreadPool *pool = nullptr;
+        return pool;
+    }
+
+    static size_t &currentIndex() {
+        thread_local size_t index = 0;
+        return index;
+    }
+
+    bool takeTask(size_t preferred, std::function<void()> &task) {
+        if (preferred < queues.size()) {
+            Queue &own = *queues[preferred];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                --pending;
+                return true;
+            }
+        }
+        for (size_t i = 1; i <= queues.size(); ++i) {
+            Queue &victim = *queues[(preferred + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --pending;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Limb buffers freed by a task are recycled within that task; the pool is
+    // emptied when it returns, so an idle worker holds no cached blocks.
+    void workerLoop(size_t index) {
+        currentPool() = this;
+        currentIndex() = index;
+        std::function<void()> task;
+        while (true) {
+            if (takeTask(index, task)) {
+                LimbPoolScope limbPool;
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCondition.wait(lock, [this] { return stopping || pending > 0; });
+            if (stopping && pending == 0) {
+                return;
+            }
+        }
+    }
+
+    size_t ownIndex() const {
+        return currentPool() == this ? currentIndex() : queues.size();
+    }
+
+public:
+    explicit ThreadPool(size_t threadCount) {
+        for (size_t i = 0; i < threadCount; ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCondition.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    size_t size() const {
+        return threads.size();
+    }
+
+    void submit(std::function<void()> task) {
+        size_t index = ownIndex();
+        if (index == queues.size()) {
+            index = nextQueue++ % queues.size();
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            ++pending;
+        }
+        sleepCondition.notify_one();
+    }
+
+    // Runs one queued task on the calling thread; used by threads waiting for
+    // their own tasks so that nested parallel loops cannot deadlock.
+    bool runPendingTask() {
+        std::function<void()> task;
+        if (!takeTask(ownIndex(), task)) {
+            return false;
+        }
+        task();
+        return true;
+    }
+
+    // Calls function(chunkBegin, chunkEnd) for consecutive chunks of at least
+    // grain indices covering [begin, end) and returns when all of them are done.
+    template<typename Function>
+    void parallelFor(size_t begin, size_t end, size_t grain, const Function &function) {
+        if (grain == 0) {
+            grain = 1;
+        }
+        size_t chunks = (end - begin + grain - 1) / grain;
+        chunks = std::min(chunks, 4 * (size() + 1));
+        if (chunks <= 1) {
+            if (begin < end) {
+                function(begin, end);
+            }
+            return;
+        }
+        const size_t step = (end - begin + chunks - 1) / chunks;
+        std::atomic<size_t> remaining{0};
+        for (size_t from = begin + step; from < end; from += step) {
+            ++remaining;
+            const size_t to = std::min(from + step, end);
+            submit([&function, &remaining, from, to] {
+                function(from, to);
+                --remaining;
+            });
+        }
+        function(begin, std::min(begin + step, end));
+        while (remaining > 0) {
+            if (!runPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+std::unique_ptr<ThreadPool> &matrixThreadPool() {
+    static std::unique_ptr<ThreadPool> pool;
+    return pool;
+}
+
+// Parallel execution of the matrix algorithms is opt-in: with threadCount <= 1
+// (the default) everything runs on the calling thread. The calling thread also
+// takes part in the work, so threadCount - 1 workers are started.
+void setMatrixThreads(size_t threadCount) {
+    if (threadCount <= 1) {
+        matrixThreadPool().reset();
+    } else {
+        matrixThreadPool() = std::make_unique<ThreadPool>(threadCount - 1);
+    }
+}
+
+size_t matrixThreads() {
+    return matrixThreadPool() ? matrixThreadPool()->size() + 1 : 1;
+}
+
+template<typename Function>
+void parallelFor(size_t begin, size_t end, size_t grain, const Function &function) {
+    if (matrixThreadPool()) {
+        matrixThreadPool()->parallelFor(begin, end, grain, function);
+    } else if (begin < end) {
+        function(begin, end);
+    }
+}